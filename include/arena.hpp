@@ -0,0 +1,71 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <sys/types.h>
+
+// Slab allocator of fixed size blocks carved from large anonymous
+// mappings (transparent huge pages when available). Freed blocks are
+// recycled through a free list threaded in their first word. Pages are
+// placed by first touch, so an arena used by one worker stays on its
+// NUMA node.
+//
+// With arena_init_file the chunks are shared mappings of an (unlinked)
+// scratch file instead, so that blocks can be evicted from RAM with
+// arena_evict and brought back by page faults or arena_prefetch while
+// their addresses stay the same. They are mapped one after the other in
+// a reserved span, so the file offset of a block is its distance to
+// the base.
+//
+// arena_map_blocks maps nblocks contiguous blocks of a file copy on
+// write as chunks of the arena, they are read on first touch and can be
+// freed as any other block. Not with arena_init_file.
+
+typedef struct {
+	size_t block_size;	// bytes per block (multiple of 64)
+	size_t chunk_size;	// bytes per chunk (multiple of 2 MB)
+	int nchunks;
+	int max_chunks;
+	char **chunks;
+	char *next;		// first never used block of the last chunk
+	char *end;
+	void *free_list;
+	size_t blocks_used;
+	int fd;			// scratch file or -1
+	char *base;		// reserved span of the file chunks or NULL
+} arena_t;
+
+void arena_init(arena_t *arena, size_t block_size);
+bool arena_init_file(arena_t *arena, size_t block_size, const char *dir);
+void *arena_alloc(arena_t *arena);
+void arena_free(arena_t *arena, void *block);
+void arena_destroy(arena_t *arena);
+void *arena_map_blocks(arena_t *arena, int fd, off_t offset, size_t nblocks);
+
+void arena_evict(arena_t *arena, void *block);
+void arena_prefetch(arena_t *arena, void *block);
+
+size_t arena_reserved(const arena_t *arena);
+size_t arena_in_use(const arena_t *arena);
+
+#endif
@@ -19,14 +19,21 @@
  */
 
 #include <vector>
+#include <string>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <unordered_map>
 #include <list>
+#include <memory>
+#include <functional>
 
 #include <cmath>
+#include <cstdio>
+#include <cstdint>
 
 #include "ell.hpp"
+#include "arena.hpp"
 
 #define MAX_MAT_PARAM 10
 #define MAX_MATS      10
@@ -34,8 +41,21 @@
 #define INT_VARS_GP   7		// eps_p_1, alpha_1
 #define NUM_VAR_GP    7		// eps_p_1, alpha_1
 
+#define INFO_VARS_NONE 0
+#define INFO_VARS_NL   1
+#define INFO_VARS_ALL  2
+
+#define STATS_BINS   16
+
+#define VTU_ASCII 0
+#define VTU_RAW   1		// binary appended data
+#define VTU_ZLIB  2		// binary appended data compressed with zlib
+#define VTU_XDMF  3		// XDMF time series with shared geometry
+
 #define glo_elem3D(ex,ey,ez) ((ez) * (nx-1) * (ny-1) + (ey) * (nx-1) + (ex))
-#define intvar_ix(e,gp,var) ((e) * 8 * INT_VARS_GP + (gp) * INT_VARS_GP + (var))
+// The variables of an element are stored by variable, its 8 Gauss points
+// next to each other (the lanes of plastic_step_8)
+#define intvar_ix(e,gp,var) ((e) * 8 * INT_VARS_GP + (var) * 8 + (gp))
 
 using namespace std;
 
@@ -43,24 +63,92 @@ struct gp_t {
 	int id;
 	int nr_its[7];
 	double *int_vars_n;
-	double *int_vars_k;
-	double macro_strain[6];
-	double macro_stress[6];
-	double macro_ctan[36];
+	double *int_vars_k;	// NULL until the first trial after a restore
+	unsigned char *int_vars_c;	// compressed int_vars_n (replaces it)
+	size_t int_vars_c_size;
+	double *rom_vars_n;	// reduced model state (get_rom_nvars())
+	double *rom_vars_k;
+	double *table_eps_n;	// strain reached on a table path (nvoi, NULL if none)
+	double *table_eps_k;
+	double *macro_strain;	// point to rows of the gp store (nvoi)
+	double *macro_stress;	// (nvoi)
+	double *macro_ctan;	// (nvoi * nvoi), ctan_lin if linear with the owned store
 	double nr_err[7];
 	double inv_max;
+	uint64_t fingerprint;	// hash of int_vars_n (0 if all zero)
+	long version;		// int_vars_k/rom_vars_k are a trial if == vars_version
+};
+
+struct cache_entry_t {
+	uint64_t fingerprint;
+	double strain[6];
+	double stress[6];
+	double ctan[36];
+	double *int_vars_n;	// committed state solved from (NULL if all zero)
+	double *int_vars;	// converged int_vars_k (NULL if elastic)
+};
+
+// Read only table of the materials, one column per material
+struct mat_table_t {
+	double E[MAX_MATS];
+	double nu[MAX_MATS];
+	double k[MAX_MATS];
+	double mu[MAX_MATS];
+	double lambda[MAX_MATS];
+	double Ka[MAX_MATS];
+	double Sy[MAX_MATS];
+	bool plasticity[MAX_MATS];
+	bool damage[MAX_MATS];
+};
+
+#define TABLE_MAGIC   "MICROPPT"
+#define TABLE_VERSION 2
+
+// Header of the homogenized response table files, followed by
+// nnodes * (nvoi + nvoi * nvoi + 1) doubles (stress, ctan, 1 if the
+// node yielded) with the first strain component running fastest.
+struct table_header_t {
+	char magic[8];
+	int32_t version;
+	int32_t nvoi;
+	int32_t size[3];
+	int32_t micro_type;
+	int32_t npts[6];
+	double eps_min[6];
+	double eps_max[6];
+	uint64_t nnodes;
+};
+
+// Copies of what write_vtu and write_info_files write, taken on the
+// compute thread and formatted by the writer
+struct writer_t;
+
+struct vtu_snapshot_t {
+	int time_step, gp_id, format;
+	vector<double> u, b;		// (nn * dim)
+	vector<double> elem_strain;	// (nelem * nvoi)
+	vector<double> elem_stress;
+	vector<double> plasticity;	// (nelem)
+	vector<double> hardening;
+	vector<int> elem_type;		// (nelem)
 };
 
-struct material_t {
-	double E;
-	double nu;
-	double k;
-	double mu;
-	double lambda;
-	double Ka;
-	double Sy;
-	bool plasticity;
-	bool damage;
+// Time series file (.xmf, .pvd) : a head, one entry per step and the
+// closing tags. Only the entry of the new step is written.
+struct series_t {
+	int nsteps, last_step;
+	long last_pos;		// offset of the entry of last_step
+};
+
+struct info_snapshot_t {
+	bool header, sur_on;
+	int ngp;
+	vector<int> id, nl_flag, nr_its;		// nr_its (ngp * 7)
+	vector<double> inv_max, nr_err;			// nr_err (ngp * 7)
+	vector<double> strain, stress, ctan;
+	vector<int> vars_ix;				// points of the int_vars rows
+	vector<double> int_vars;			// (vars_ix.size() * num_int_vars)
+	int sur_served, sur_solved, sur_n;
 };
 
 class micropp_t {
@@ -73,13 +161,24 @@ class micropp_t {
 		const int micro_type, num_int_vars;
 
 		bool output_files_header;
+		int vtu_format;
 
 		double micro_params[5];
 		int numMaterials;
-		material_t material_list[MAX_MATS];
+		mat_table_t mats;
 		double ctan_lin[36];
 
-		list<gp_t> gauss_list;
+		vector<gp_t> gauss_list;
+		unordered_map<int, int> gauss_map;	// gp_id -> index in gauss_list
+
+		// Structure of arrays store of the gp strains/stresses/ctans,
+		// row i belongs to gauss_list[i]. It is either owned by micropp
+		// or registered by the caller with set_gp_buffers.
+		double *gp_strain;
+		double *gp_stress;
+		double *gp_ctan;
+		int gp_capacity;
+		bool gp_store_owned;
 
 		ell_matrix A;
 		double * u;
@@ -89,29 +188,266 @@ class micropp_t {
 		double * elem_stress;
 		double * elem_strain;
 		int * elem_type;
-		double * vars_old;
-		double * vars_new;
+		uint8_t * elem_mat;	// material of every element (column of mats)
+		double dsh_gp[8][3][8];	// shape derivatives [gp][dir][node] (3D)
+		double * vars_old;	// state read/written by the Newton loop, they
+		double * vars_new;	// point to the buffers or to the gp in solve_gp
+		double * vars_old_buf;
+		double * vars_new_buf;
+		long vars_version;	// step of the trial int_vars_k
+		vector<int> vars_first;	// gp ids without history in this step
+		arena_t vars_arena;	// blocks of num_int_vars doubles
+
+		// Deduplication of identical committed int_vars : block ->
+		// (references from int_vars_n/int_vars_k, fingerprint)
+		bool dedup_on;
+		unordered_map<double *, pair<int, uint64_t>> dedup_ref;
+		unordered_map<uint64_t, vector<double *>> dedup_map;
+
+		// Compression of the committed int_vars
+		bool comp_on;
+		double comp_tol;
+
+		// Bounded memory mode : at most spill_max points keep their
+		// int_vars in RAM, the least recently used go to scratch
+		bool spill_on;
+		int spill_max;
+		long spill_evictions;
+		list<int> spill_lru;			// gp ids, most recent first
+		unordered_map<int, list<int>::iterator> spill_map;
 
 		double inv_max;
 
+		// Response cache for the non-linear solves
+		bool cache_on;
+		double cache_tol;
+		int cache_max, cache_next;
+		long cache_hits, cache_near_hits, cache_misses;
+		vector<cache_entry_t> cache_list;
+		unordered_map<uint64_t, vector<int>> cache_map;	// fingerprint -> entries
+
+		// Memory mapped response table
+		bool table_on;
+		size_t table_bytes;
+		const table_header_t *table_header;
+		const double *table_data;
+		long table_hits;
+
+		// Clustering reduced order model
+		bool rom_on;
+		int rom_nclus;
+		vector<int> rom_elem_clus;	// cluster of each element
+		vector<int> rom_clus_mat;	// material of each cluster
+		vector<double> rom_frac;	// volume fractions
+		vector<double> rom_A;		// strain concentration (nclus * 36)
+		vector<double> rom_D;		// interaction (6 nclus x 6 nclus)
+
+		// POD reduced basis with empirical cubature
+		bool pod_on, pod_snap_on;
+		int pod_nsnap, pod_nmodes, pod_npts;
+		vector<double> pod_snap_u;	// fluctuation snapshots (nsnap * nn * dim)
+		vector<double> pod_snap_s;	// their gp stresses (nsnap * nelem * 8 * 6)
+		vector<double> pod_phi;		// modes (nmodes * nn * dim)
+		vector<int> pod_mat;		// material of each cubature point
+		vector<double> pod_w;		// cubature weights
+		vector<double> pod_bphi;	// B phi at the cubature points (npts * 6 * nmodes)
+		double pod_vol;
+
+		// Gaussian process surrogate trained with the full solves
+		bool sur_on;
+		double sur_tol, sur_len;
+		int sur_max, sur_n;
+		int sur_served, sur_solved;	// in the last homogenize
+		vector<double> sur_x;		// training inputs (max * (nvoi + 1))
+		vector<double> sur_z;		// L^-1 Y (max * (nvoi + nvoi * nvoi))
+		vector<double> sur_L;		// Cholesky factor of K (max * max)
+		vector<double *> sur_vars;	// converged int_vars (NULL if elastic)
+		vector<double *> sur_vars_n;	// int_vars_n solved from (NULL if all zero)
+
+		// Background writer of the write_vtu and write_info_files jobs
+		// (NULL if the output is synchronous)
+		struct writer_t *writer;
+
+		// Time steps in the XDMF fields file of every point and in the
+		// collection of the collective output, only used by the writer jobs
+		unordered_map<int, series_t> xdmf_series;
+		series_t pvd_series;		// of micropp.pvd
+		series_t xmf_series;		// of micropp.xmf
+
+		// Strain and converged u (nvoi + nn * dim) of the watched points
+		unordered_map<int, vector<double>> watch_u;
+		long watch_hits, watch_solves;
+
+		// In-situ statistics of the points solved by the last homogenize
+		bool stats_on;
+		int stats_stride, stats_ncoarse[3];
+		FILE *stats_file;
+		vector<double> stats_ip;	// stress and alpha of the integration points
+		vector<int> stats_id;
+		vector<double> stats_rec;	// (stats_id.size() * get_stats_size())
+
+		// Columnar binary log, its files are written by the writer jobs
+		bool log_on;
+		string log_prefix;
+		int log_vars_every, log_step, log_ngp;
+		vector<FILE *> log_files;	// the columns, then the int_vars
+
 	public:
+		// num_mats > 2 materials are only reached by load_voxels
 		micropp_t(const int dim, const int size[3], const int micro_type, const double *micro_params,
-		          const int *mat_types, const double *params);
+		          const int *mat_types, const double *params, const int num_mats = 2);
 		~micropp_t();
 
 		void calc_ctan_lin();
 
 		bool is_linear(const double *macro_strain);
+		void calc_lin_stress(const int ngp, const double *strain, double *stress);
 
 		double get_inv_1(const double *tensor);
+		void get_inv_1(const int n, const double *tensor, double *inv);
 		double get_inv_2(const double *tensor);
 
+		// The int_vars of the points, cache and surrogate come from
+		// vars_arena
+		double *alloc_int_vars(const bool zero);
+		void free_int_vars(double *int_vars);
+		void get_arena_stats(size_t *reserved, size_t *in_use);
+
+		// Shares the identical committed int_vars between the points. At
+		// update_vars the new states are hashed and int_vars_n and
+		// int_vars_k of a point point to the same shared block, which is
+		// copied on the next write to int_vars_k. Not with compression.
+		void set_dedup(const bool on);
+		void get_dedup_stats(long *blocks_logical, long *blocks_physical);
+		double *dedup_commit(double *int_vars);
+		void unshare_int_vars_k(gp_t &gp);
+		void reshare_int_vars_k(gp_t &gp);
+
+		// Keeps the committed int_vars of the points compressed (zero run
+		// length and, with tol > 0, int32 quantization with error <= tol).
+		// int_vars_n is replaced by int_vars_c and int_vars_k only lives
+		// between homogenize and update_vars. Not with the cache, the
+		// surrogate or the spill.
+		void set_compression(const bool on, const double tol);
+		void get_compression_stats(size_t *raw, size_t *compressed);
+		size_t compress_vars(const double *vars, unsigned char **buf);
+		void decompress_vars(const unsigned char *buf, double *vars);
+		void load_int_vars_n(const gp_t &gp, double *vars);
+
+		// Puts the int_vars in a scratch file in dir, keeping about
+		// ram_budget bytes of them in RAM. It has to be called before any
+		// point becomes non-linear.
+		bool set_spill(const char *dir, const size_t ram_budget);
+		void get_spill_stats(long *evictions, int *resident);
+		void spill_touch(const gp_t &gp);
+		void spill_forget(const int gp_id);
+
+		int get_gp_ix(const int gp_id);
+		int add_gp(const int gp_id);
+		void resize_gp_store(const int capacity);
+		void bind_gp_store();
+
+		// Registers caller arrays (ngp * nvoi strains and stresses, ngp *
+		// nvoi * nvoi ctans) as the gp store. homogenize reads the strains
+		// and writes the results there with no extra copies. The gp table
+		// becomes exactly gp_id[0 .. ngp-1] in that order.
+		void set_gp_buffers(const int ngp, const int *gp_id, double *macro_strain,
+		                    double *macro_stress, double *macro_ctan);
+
 		void set_macro_strain(const int gp_id, const double *macro_strain);
 		void get_macro_stress(const int gp_id, double *macro_stress);
 		void get_macro_ctan(const int gp_id, double *macro_ctan);
 
+		// Batched versions : ngp ids with ngp * nvoi strains/stresses
+		// and ngp * nvoi * nvoi tangents stored contiguously
+		void set_macro_strains(const int ngp, const int *gp_id, const double *macro_strain);
+		void get_macro_stresses(const int ngp, const int *gp_id, double *macro_stress);
+		void get_macro_ctans(const int ngp, const int *gp_id, double *macro_ctan);
+
+		// Cache of (macro strain, int_vars_n) -> (stress, ctan, int_vars_k).
+		// Strains closer than tol (2-norm) to a stored one are interpolated
+		// with the stored ctan.
+		void set_cache(const bool on, const double tol, const int max_entries);
+		void get_cache_stats(long *hits, long *near_hits, long *misses);
+		uint64_t get_fingerprint(const double *int_vars);
+		bool cache_lookup(gp_t &gp);
+		void cache_insert(const gp_t &gp, const bool nl_flag);
+		void cache_clear();
+
+		// Response table over a regular grid of strains computed from the
+		// virgin state (valid for monotonic loading). While a table is
+		// loaded the points inside the grid are answered by multilinear
+		// interpolation while their strain grows along the ray of the last
+		// one served, the state of a point that reached a yielded cell is
+		// that strain (table_eps_n). When the path stops being monotonic
+		// table_restore solves the point from the virgin state to it and
+		// it continues with int_vars.
+		void write_table(const char *fname, const int *npts,
+		                 const double *eps_min, const double *eps_max);
+		bool load_table(const char *fname);
+		void unload_table();
+		bool table_lookup(gp_t &gp);
+		void table_restore(gp_t &gp);
+		long get_table_hits();
+
+		// Reduced order model with nclus clusters per material (3D only).
+		// While it is on the non-linear points are solved with it.
+		// get_rom_error compares the active reduced model (the clusters
+		// unless the POD one is on) with the full one.
+		void calc_clusters(const int nclus);
+		void set_rom(const bool on);
+		double get_rom_error(const double *macro_strain);
+		void calc_elem_strain_ave(double *strain);
+		int get_rom_nvars();
+		static void solve_dense(const int n, double *a, double *b);
+		void rom_point_stress(const int mat, const double eps[6], const double *vars_n,
+		                      double eps_p[6], double *alpha, bool *non_linear,
+		                      double stress[6]);
+		void rom_solve(const double *macro_strain, const double *vars_n, double *vars_k,
+		               double *macro_stress, bool *non_linear, int *its, double *err);
+		void rom_solve_gp(gp_t &gp);
+
+		// POD/Galerkin reduced model (3D only). While snapshots are on
+		// every full solve stores its displacement fluctuation and gp
+		// stresses. calc_pod keeps up to nmodes modes (energy tolerance
+		// tol) and selects the cubature points integrating the snapshot
+		// internal forces within tol, the snapshots are then released.
+		// set_pod and set_rom are exclusive, they share gp.rom_vars.
+		void set_pod_snapshots(const bool on);
+		void pod_add_snapshot(const double *macro_strain);
+		void calc_pod(const int nmodes, const double tol);
+		void set_pod(const bool on);
+		void get_pod_size(int *nmodes, int *npts);
+		void pod_solve(const double *macro_strain, const double *vars_n, double *vars_k,
+		               double *macro_stress, bool *non_linear, int *its, double *err);
+
+		// Gaussian process surrogate over the macro strain and the mean
+		// alpha of the committed state, both divided by length. The points
+		// with predictive variance (relative to the prior) under tol are
+		// answered by it if the closest training point has the same
+		// committed state, the others are solved and added to the training
+		// set (up to max_points).
+		void set_surrogate(const bool on, const double tol, const int max_points,
+		                   const double length);
+		void get_surrogate_stats(int *served, int *solved);
+		double get_state_summary(const double *int_vars);
+		void surrogate_input(const gp_t &gp, double *x);
+		double surrogate_solve(const double *x, double *v);
+		bool surrogate_lookup(gp_t &gp);
+		void surrogate_insert(const gp_t &gp);
+		void surrogate_clear();
+
 		void homogenize();
+		void solve_gp(gp_t &gp);
+
+		// The committed (int_vars_n) and trial (int_vars_k) states are
+		// double buffered : the trials written in this step carry
+		// vars_version, update_vars swaps them in and rollback_vars
+		// discards all of them by moving to the next version. The points
+		// that yielded for the first time in the step are released.
 		void update_vars();
+		void rollback_vars();
+		void reset_int_vars_k(gp_t &gp);
 		void get_nl_flag(int gp_id, int *nl_flag);
 
 		void set_displ(double *eps);
@@ -124,6 +460,8 @@ class micropp_t {
 
 		void get_elem_mat2D(int ex, int ey, double (&Ae)[2 * 4 * 2 * 4]);
 		void get_elem_mat3D(int ex, int ey, int ez, double (&Ae)[3 * 8 * 3 * 8]);
+		void get_elem_mat_btcb(const double ctan[6][6][8], double (&Ae)[3 * 8 * 3 * 8]);
+		void calc_dsh_gp();
 
 		void solve();
 		void newton_raphson(bool *nl_flag, int *its, double *err);
@@ -134,6 +472,7 @@ class micropp_t {
 
 		void get_strain2D(int ex, int ey, int gp, double *strain_gp);
 		void get_strain3D(int ex, int ey, int ez, int gp, double *strain_gp);
+		void get_elem_strain3D(int ex, int ey, int ez, double strain[6][8]);
 
 		void get_stress2D(int ex, int ey, int gp, double strain_gp[3],
 		                  bool *nl_flag, double *stress_gp);
@@ -142,24 +481,118 @@ class micropp_t {
 		                  bool *nl_flag, double *stress_gp);
 
 		void get_dev_tensor(double tensor[6], double tensor_dev[6]);
-		void plastic_step(material_t *material, double eps[6], double eps_p_1[6], double alpha_1,
+		void plastic_step(const int mat, double eps[6], double eps_p_1[6], double alpha_1,
 		                  double eps_p[6], double *alpha, bool *nl_flag, double stress[6]);
 
+		// All the Gauss points of an element at once, [voigt][gp]
+		void get_elem_stress3D(int ex, int ey, int ez, const double strain[6][8],
+		                       bool *nl_flag, double stress[6][8]);
+		void plastic_step_8(const int mat, const double eps[6][8], const double *vars_old_e,
+		                    double *vars_new_e, bool *nl_flag, double stress[6][8]);
+
 		void getElemDisp(int ex, int ey, double *elem_disp);
 		void getElemDisp(int ex, int ey, int ez, double *elem_disp);
 
+		void calc_elem_types();
+		void calc_elem_mats();
 		int get_elem_type2D(int ex, int ey);
 		int get_elem_type3D(int ex, int ey, int ez);
 
-		void get_material(int e, material_t &material);
+		// Replaces the micro_type geometry by a raw image of nvox[0] x
+		// nvox[1] x nvox[2] uint8 phases (x fastest) starting at offset
+		// bytes of fname. Every element takes the phase of the voxel at
+		// its position, so the image can be finer than the mesh. It has
+		// to be called before any point is solved.
+		bool load_voxels(const char *fname, const int nvox[3], const size_t offset);
+
 
 		void calc_bmat_3D(int gp, double bmat[6][3 *8]);
 
 		void calc_fields();
-		void calc_ave_stress(double stress_ave[6]);
+		// With ip_vals the stress and alpha of every integration point
+		// ((e * npe + gp) * (nvoi + 1)) are also stored
+		void calc_ave_stress(double stress_ave[6], double *ip_vals = NULL);
 		void calc_ave_strain(double strain_ave[6]);
 
+		// VTU_ASCII, VTU_RAW, VTU_ZLIB (false if built without zlib) or
+		// VTU_XDMF. With VTU_XDMF output() writes for every point
+		// micropp_<gp_id>_geom.bin once, appends the step fields to
+		// micropp_<gp_id>_fields.bin and its grid to micropp_<gp_id>.xmf.
+		bool set_vtu_format(const int format);
+		void get_grid(vector<double> &coor, vector<int32_t> &conn);
+
+		// homogenize keeps the converged u of the watched points that it
+		// solves and output() only post-processes them. The others, or
+		// those served by the table, the reduced models, the cache or the
+		// surrogate, are solved again by output().
+		void set_watch(const int ngp, const int *gp_id);
+		void get_watch_stats(long *hits, long *solves);
+		void watch_store(const gp_t &gp);
+		bool watch_load(const gp_t &gp);
+
 		void output(int tstep, int gp_id);
+		bool output_fields(const int gp_id);
 		void write_vtu(int tstep, int gp_id);
+		void take_vtu_snapshot(vtu_snapshot_t &snap, const int time_step, const int gp_id);
+		void write_vtu_snapshot(const vtu_snapshot_t &snap);
+		void write_vtu_ascii(const vtu_snapshot_t &snap);
+		void write_vtu_appended(const vtu_snapshot_t &snap);
+		void write_xdmf(const vtu_snapshot_t &snap);
+		string get_xdmf_grid(const string &name, const int gp_id, const int time_step,
+		                     const long rec);
+		void append_series(const string &fname, series_t &series, const int time_step,
+		                   const string &head, const string &entry, const string &tail);
+
+		// output() of ngp points at once : their VTU are written by
+		// nthreads threads and indexed by micropp_<tstep>.vtm, micropp.pvd
+		// collects the steps. With VTU_XDMF the grids of the step are a
+		// spatial collection in the temporal one of micropp.xmf. The fields
+		// are still computed one point after the other, the watched points
+		// save their solve, and they go to the writer in batches.
+		void output_collective(const int tstep, const int ngp, const int *gp_id,
+		                       const int nthreads);
+		void write_vtm(const vector<int> &gp_id, const int format, const int tstep);
 		void write_info_files();
+		void take_info_snapshot(info_snapshot_t &snap, const int vars_rows);
+		void write_info_snapshot(const info_snapshot_t &snap);
+
+		// With on the output is written by a background thread, at most
+		// max_jobs snapshots wait for it (the caller blocks on a full
+		// queue). io_flush waits until all of them are on disk, it is
+		// also done when the writer is stopped and at destruction.
+		void set_async_output(const bool on, const int max_jobs);
+		void io_submit(function<void()> job);
+		void io_flush();
+
+		// Columnar binary log : prefix.hdr describes the columns and every
+		// write_log appends a row of ngp values to each prefix_<name>.bin.
+		// Every vars_every steps (0 = never) the int_vars of the non-linear
+		// points go to prefix_int_vars.bin as (step, gp_id, int_vars)
+		// records. scripts/read_log.py reads them.
+		bool open_log(const char *prefix, const int vars_every);
+		void write_log();
+		void close_log();
+		void write_log_snapshot(const info_snapshot_t &snap, const int step);
+
+		// In-situ statistics of the points solved by homogenize, taken in
+		// the converged stress pass instead of writing their fields : per
+		// material volume fraction, average stress, max von Mises and plastic
+		// volume fraction, a histogram of von Mises / max and, with stride
+		// > 0, von Mises averaged over blocks of stride^dim elements.
+		// write_stats appends the records of the last homogenize to fname.
+		bool open_stats(const char *fname, const int stride);
+		void close_stats();
+		int get_stats_size();
+		bool get_stats(const int gp_id, double *rec);
+		void calc_stats(const gp_t &gp);
+		void write_stats(const int time_step);
+		double get_von_mises(const double *stress);
+
+		// Checkpoint of the committed state (call it after update_vars) :
+		// ids, macro strains/stresses/ctans, int_vars_n and ctan_lin. The
+		// file is written by the writer jobs. load_checkpoint replaces the
+		// points, their int_vars are mapped from the file and read when
+		// first touched. The reduced model and table path states are not saved.
+		void write_checkpoint(const char *fname);
+		bool load_checkpoint(const char *fname);
 };
@@ -0,0 +1,113 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIMD_H_
+#define SIMD_H_
+
+// Vectors of VW doubles for the kernels that work on the 8 Gauss points
+// (or nodes) of an element at once. VW is the widest the library is
+// compiled for : 8 with AVX-512, 4 with AVX/AVX2, 2 with SSE2, else 1.
+// vsel(m, a, b) is a where the mask m is set and b elsewhere.
+
+#include <cmath>
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512F__)
+
+#define VW 8
+typedef __m512d vd;
+typedef __mmask8 vm;
+static inline vd vset(double a) { return _mm512_set1_pd(a); }
+static inline vd vload(const double *p) { return _mm512_loadu_pd(p); }
+static inline void vstore(double *p, vd a) { _mm512_storeu_pd(p, a); }
+static inline vd vadd(vd a, vd b) { return _mm512_add_pd(a, b); }
+static inline vd vsub(vd a, vd b) { return _mm512_sub_pd(a, b); }
+static inline vd vmul(vd a, vd b) { return _mm512_mul_pd(a, b); }
+static inline vd vdiv(vd a, vd b) { return _mm512_div_pd(a, b); }
+static inline vd vsqrt(vd a) { return _mm512_sqrt_pd(a); }
+static inline vm vgt(vd a, vd b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+static inline vd vsel(vm m, vd a, vd b) { return _mm512_mask_blend_pd(m, b, a); }
+static inline bool vany(vm m) { return m != 0; }
+static inline double vsum(vd a) { return _mm512_reduce_add_pd(a); }
+
+#elif defined(__AVX__)
+
+#define VW 4
+typedef __m256d vd;
+typedef __m256d vm;
+static inline vd vset(double a) { return _mm256_set1_pd(a); }
+static inline vd vload(const double *p) { return _mm256_loadu_pd(p); }
+static inline void vstore(double *p, vd a) { _mm256_storeu_pd(p, a); }
+static inline vd vadd(vd a, vd b) { return _mm256_add_pd(a, b); }
+static inline vd vsub(vd a, vd b) { return _mm256_sub_pd(a, b); }
+static inline vd vmul(vd a, vd b) { return _mm256_mul_pd(a, b); }
+static inline vd vdiv(vd a, vd b) { return _mm256_div_pd(a, b); }
+static inline vd vsqrt(vd a) { return _mm256_sqrt_pd(a); }
+static inline vm vgt(vd a, vd b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+static inline vd vsel(vm m, vd a, vd b) { return _mm256_blendv_pd(b, a, m); }
+static inline bool vany(vm m) { return _mm256_movemask_pd(m) != 0; }
+static inline double vsum(vd a)
+{
+	const __m128d h = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+#elif defined(__SSE2__)
+
+#define VW 2
+typedef __m128d vd;
+typedef __m128d vm;
+static inline vd vset(double a) { return _mm_set1_pd(a); }
+static inline vd vload(const double *p) { return _mm_loadu_pd(p); }
+static inline void vstore(double *p, vd a) { _mm_storeu_pd(p, a); }
+static inline vd vadd(vd a, vd b) { return _mm_add_pd(a, b); }
+static inline vd vsub(vd a, vd b) { return _mm_sub_pd(a, b); }
+static inline vd vmul(vd a, vd b) { return _mm_mul_pd(a, b); }
+static inline vd vdiv(vd a, vd b) { return _mm_div_pd(a, b); }
+static inline vd vsqrt(vd a) { return _mm_sqrt_pd(a); }
+static inline vm vgt(vd a, vd b) { return _mm_cmpgt_pd(a, b); }
+static inline vd vsel(vm m, vd a, vd b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+static inline bool vany(vm m) { return _mm_movemask_pd(m) != 0; }
+static inline double vsum(vd a) { return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a))); }
+
+#else
+
+#define VW 1
+typedef double vd;
+typedef bool vm;
+static inline vd vset(double a) { return a; }
+static inline vd vload(const double *p) { return *p; }
+static inline void vstore(double *p, vd a) { *p = a; }
+static inline vd vadd(vd a, vd b) { return a + b; }
+static inline vd vsub(vd a, vd b) { return a - b; }
+static inline vd vmul(vd a, vd b) { return a * b; }
+static inline vd vdiv(vd a, vd b) { return a / b; }
+static inline vd vsqrt(vd a) { return sqrt(a); }
+static inline vm vgt(vd a, vd b) { return a > b; }
+static inline vd vsel(vm m, vd a, vd b) { return m ? a : b; }
+static inline bool vany(vm m) { return m; }
+static inline double vsum(vd a) { return a; }
+
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+# Reader of the columnar binary log of MicroPP (micropp_t::open_log)
+#
+#   python read_log.py prefix [column]
+#
+# or from python :
+#
+#   log = read_log("micropp_log")
+#   log["stress"][step, gp, :]    # (nsteps, ngp, width) memory maps
+#   log["int_vars"]               # records (step, gp_id, vars)
+
+import sys
+import numpy as np
+
+def read_log(prefix):
+    hdr = open(prefix + ".hdr", "rb").read()
+    if hdr[0:8] != b"MICROPPL":
+        raise IOError(prefix + ".hdr is not a MicroPP log")
+
+    version, nvoi, ngp, ncols, num_int_vars, vars_every = \
+        np.frombuffer(hdr, dtype=np.int32, count=6, offset=8)
+    pos = 8 + 6 * 4
+
+    log = {"nvoi": nvoi, "ngp": ngp, "vars_every": vars_every}
+    for c in range(ncols):
+        name = hdr[pos:pos + 16].split(b"\0")[0].decode()
+        typ, width = np.frombuffer(hdr, dtype=np.int32, count=2, offset=pos + 16)
+        pos += 16 + 8
+        dtype = np.int32 if typ == 0 else np.float64
+        data = np.memmap(prefix + "_" + name + ".bin", dtype=dtype, mode="r")
+        log[name] = data.reshape(-1, ngp, width)
+    log["gp_id"] = np.frombuffer(hdr, dtype=np.int32, count=ngp, offset=pos)
+
+    rec = np.dtype([("step", np.int32), ("gp_id", np.int32),
+                    ("vars", np.float64, (num_int_vars,))])
+    log["int_vars"] = np.fromfile(prefix + "_int_vars.bin", dtype=rec)
+    return log
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("usage : read_log.py prefix [column]")
+        sys.exit(1)
+
+    log = read_log(sys.argv[1])
+    if len(sys.argv) > 2:
+        np.set_printoptions(linewidth=200)
+        print(log[sys.argv[2]])
+    else:
+        print("gp_id : " + str(log["gp_id"]))
+        for name in ["nl_flag", "inv_max", "nr_its", "nr_err", "strain", "stress", "ctan"]:
+            print(name + " : " + str(log[name].shape))
+        print("int_vars records : " + str(len(log["int_vars"])))
@@ -0,0 +1,254 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "arena.hpp"
+
+#define ARENA_ALIGN     64
+#define ARENA_HUGE_PAGE (2UL << 20)
+#define ARENA_CHUNK_MIN (4UL << 20)
+#define ARENA_FILE_SPAN (1UL << 40)
+
+void arena_init(arena_t *arena, size_t block_size)
+{
+	assert(block_size >= sizeof(void *));
+
+	arena->block_size = (block_size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+
+	size_t nblocks = ARENA_CHUNK_MIN / arena->block_size;
+	if (nblocks < 1)
+		nblocks = 1;
+	arena->chunk_size = (nblocks * arena->block_size + ARENA_HUGE_PAGE - 1) /
+		ARENA_HUGE_PAGE * ARENA_HUGE_PAGE;
+
+	arena->nchunks = 0;
+	arena->max_chunks = 0;
+	arena->chunks = NULL;
+	arena->next = NULL;
+	arena->end = NULL;
+	arena->free_list = NULL;
+	arena->blocks_used = 0;
+	arena->fd = -1;
+	arena->base = NULL;
+}
+
+bool arena_init_file(arena_t *arena, size_t block_size, const char *dir)
+{
+	// Blocks are page aligned so that they can be evicted one by one
+	const size_t page = sysconf(_SC_PAGESIZE);
+	arena_init(arena, (block_size + page - 1) / page * page);
+
+	char fname[4096];
+	snprintf(fname, sizeof(fname), "%s/micropp_spill_XXXXXX", dir);
+	arena->fd = mkstemp(fname);
+	if (arena->fd < 0) {
+		perror("arena : mkstemp");
+		return false;
+	}
+	unlink(fname);
+
+	// Address space only, the chunks are mapped over it
+	void *ptr = mmap(NULL, ARENA_FILE_SPAN, PROT_NONE,
+	                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (ptr == MAP_FAILED) {
+		perror("arena : mmap");
+		close(arena->fd);
+		arena->fd = -1;
+		return false;
+	}
+	arena->base = (char *) ptr;
+	return true;
+}
+
+static char *arena_map_file_chunk(arena_t *arena, off_t offset, size_t size)
+{
+	if (offset + size > ARENA_FILE_SPAN) {
+		fprintf(stderr, "arena : the scratch file span is full\n");
+		return NULL;
+	}
+	if (ftruncate(arena->fd, offset + size) != 0) {
+		perror("arena : ftruncate");
+		return NULL;
+	}
+	void *ptr = mmap(arena->base + offset, size, PROT_READ | PROT_WRITE,
+	                 MAP_SHARED | MAP_FIXED, arena->fd, offset);
+	if (ptr == MAP_FAILED) {
+		perror("arena : mmap");
+		return NULL;
+	}
+	return (char *) ptr;
+}
+
+static char *arena_map_chunk(size_t size)
+{
+	// Over map by a huge page to align the chunk on it
+	const size_t size_map = size + ARENA_HUGE_PAGE;
+	void *ptr = mmap(NULL, size_map, PROT_READ | PROT_WRITE,
+	                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED) {
+		perror("arena : mmap");
+		return NULL;
+	}
+
+	const uintptr_t addr = (uintptr_t) ptr;
+	const uintptr_t addr_al = (addr + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);
+	if (addr_al > addr)
+		munmap(ptr, addr_al - addr);
+	if (addr_al + size < addr + size_map)
+		munmap((void *) (addr_al + size), addr + size_map - addr_al - size);
+
+#ifdef MADV_HUGEPAGE
+	madvise((void *) addr_al, size, MADV_HUGEPAGE);
+#endif
+	return (char *) addr_al;
+}
+
+void *arena_alloc(arena_t *arena)
+{
+	void *block;
+
+	if (arena->free_list != NULL) {
+		block = arena->free_list;
+		arena->free_list = *(void **) block;
+	} else {
+		if (arena->next == arena->end) {
+			char *chunk = (arena->fd < 0) ?
+				arena_map_chunk(arena->chunk_size) :
+				arena_map_file_chunk(arena, arena->nchunks * arena->chunk_size,
+				                     arena->chunk_size);
+			if (chunk == NULL)
+				return NULL;
+			if (arena->nchunks == arena->max_chunks) {
+				arena->max_chunks = 2 * arena->max_chunks + 1;
+				arena->chunks = (char **) realloc(arena->chunks,
+				                                  arena->max_chunks * sizeof(char *));
+			}
+			arena->chunks[arena->nchunks++] = chunk;
+			arena->next = chunk;
+			arena->end = chunk + arena->chunk_size / arena->block_size * arena->block_size;
+		}
+		block = arena->next;
+		arena->next += arena->block_size;
+	}
+
+	arena->blocks_used++;
+	return block;
+}
+
+void arena_free(arena_t *arena, void *block)
+{
+	if (block == NULL)
+		return;
+
+	*(void **) block = arena->free_list;
+	arena->free_list = block;
+	arena->blocks_used--;
+}
+
+void arena_destroy(arena_t *arena)
+{
+	if (arena->base != NULL)
+		munmap(arena->base, ARENA_FILE_SPAN);
+	else
+		for (int i = 0; i < arena->nchunks; ++i)
+			munmap(arena->chunks[i], arena->chunk_size);
+	free(arena->chunks);
+	if (arena->fd >= 0)
+		close(arena->fd);
+
+	arena->fd = -1;
+	arena->base = NULL;
+	arena->nchunks = 0;
+	arena->max_chunks = 0;
+	arena->chunks = NULL;
+	arena->next = NULL;
+	arena->end = NULL;
+	arena->free_list = NULL;
+	arena->blocks_used = 0;
+}
+
+void *arena_map_blocks(arena_t *arena, int fd, off_t offset, size_t nblocks)
+{
+	// offset has to be page aligned, the pages past the end of the file
+	// are mapped but never touched
+	if (arena->fd >= 0 || nblocks == 0)
+		return NULL;
+
+	const size_t n = (nblocks * arena->block_size + arena->chunk_size - 1) / arena->chunk_size;
+	void *ptr = mmap(NULL, n * arena->chunk_size, PROT_READ | PROT_WRITE,
+	                 MAP_PRIVATE, fd, offset);
+	if (ptr == MAP_FAILED) {
+		perror("arena : mmap");
+		return NULL;
+	}
+
+	if (arena->nchunks + (int) n > arena->max_chunks) {
+		arena->max_chunks = 2 * arena->max_chunks + n;
+		arena->chunks = (char **) realloc(arena->chunks,
+		                                  arena->max_chunks * sizeof(char *));
+	}
+	for (size_t i = 0; i < n; ++i)
+		arena->chunks[arena->nchunks++] = (char *) ptr + i * arena->chunk_size;
+
+	arena->blocks_used += nblocks;
+	return ptr;
+}
+
+void arena_evict(arena_t *arena, void *block)
+{
+	// Writes the block to the scratch file and drops its pages
+	if (arena->fd < 0 || block == NULL)
+		return;
+
+	const off_t offset = (char *) block - arena->base;
+	if (offset < 0 || (size_t) offset >= arena->nchunks * arena->chunk_size)
+		return;
+
+	msync(block, arena->block_size, MS_SYNC);
+	madvise(block, arena->block_size, MADV_DONTNEED);
+	posix_fadvise(arena->fd, offset, arena->block_size, POSIX_FADV_DONTNEED);
+}
+
+void arena_prefetch(arena_t *arena, void *block)
+{
+	// Asynchronous read ahead of an evicted block
+	if (arena->fd < 0 || block == NULL)
+		return;
+	madvise(block, arena->block_size, MADV_WILLNEED);
+}
+
+size_t arena_reserved(const arena_t *arena)
+{
+	return arena->nchunks * arena->chunk_size;
+}
+
+size_t arena_in_use(const arena_t *arena)
+{
+	return arena->blocks_used * arena->block_size;
+}
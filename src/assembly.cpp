@@ -370,14 +370,11 @@ void micropp_t::get_elem_mat2D(int ex, int ey, double (&Ae)[2 * 4 * 2 * 4])
 	double ctan[3][3];
 	bool plasticity;
 
-	int e = glo_elem3D(ex, ey, 0);
+	const int m = elem_mat[glo_elem3D(ex, ey, 0)];
 
-	material_t material;
-	get_material(e, material);
-
-	E = material.E;
-	nu = material.nu;
-	plasticity = material.plasticity;
+	E = mats.E[m];
+	nu = mats.nu[m];
+	plasticity = mats.plasticity[m];
 
 	ctan[0][0] = (1 - nu);
 	ctan[0][1] = nu;
@@ -444,25 +441,17 @@ void micropp_t::get_elem_mat2D(int ex, int ey, double (&Ae)[2 * 4 * 2 * 4])
 
 void micropp_t::get_elem_mat3D(int ex, int ey, int ez, double (&Ae)[3 * 8 * 3 * 8])
 {
-	int e = glo_elem3D(ex, ey, ez);
-	material_t material;
-	get_material(e, material);
+	const int mat = elem_mat[glo_elem3D(ex, ey, ez)];
 	double ctan[6][6];
 
-	/*
-	  C = lambda * (1x1) + 2 mu I
-	  last 3 components are without the 2 because we use eps = {e11 e22 e33 2*e12 2*e13 2*e23}
-	*/
-
-	for (int i = 0; i < npe * dim * npe * dim; i++)
-		Ae[i] = 0.0;
-
-	for (int gp = 0; gp < 8; gp++) {
-		if (material.plasticity == true) {
-			bool ctan_secant = false;
-			bool ctan_pert = true;
-			bool ctan_exact = false;
+	if (mats.plasticity[mat] == true) {
+		bool ctan_secant = false;
+		bool ctan_pert = true;
+		bool ctan_exact = false;
 
+		// The tangent differs at every Gauss point
+		double ctan_gp[6][6][8];
+		for (int gp = 0; gp < 8; gp++) {
 			if (ctan_secant == true)
 				get_ctan_plast_sec(ex, ey, ez, gp, ctan);
 			else if (ctan_exact == true)
@@ -470,23 +459,37 @@ void micropp_t::get_elem_mat3D(int ex, int ey, int ez, double (&Ae)[3 * 8 * 3 *
 			else if (ctan_pert == true)
 				get_ctan_plast_pert(ex, ey, ez, gp, ctan);
 
-		} else {
-
 			for (int i = 0; i < 6; i++)
 				for (int j = 0; j < 6; j++)
-					ctan[i][j] = 0.0;
+					ctan_gp[i][j][gp] = ctan[i][j];
+		}
+		get_elem_mat_btcb(ctan_gp, Ae);
+		return;
+	}
+
+	/*
+	  C = lambda * (1x1) + 2 mu I
+	  last 3 components are without the 2 because we use eps = {e11 e22 e33 2*e12 2*e13 2*e23}
+	*/
+
+	for (int i = 0; i < 6; i++)
+		for (int j = 0; j < 6; j++)
+			ctan[i][j] = 0.0;
+
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			ctan[i][j] += mats.lambda[mat];
 
-			for (int i = 0; i < 3; i++)
-				for (int j = 0; j < 3; j++)
-					ctan[i][j] += material.lambda;
+	for (int i = 0; i < 3; i++)
+		ctan[i][i] += 2 * mats.mu[mat];
 
-			for (int i = 0; i < 3; i++)
-				ctan[i][i] += 2 * material.mu;
+	for (int i = 3; i < 6; i++)
+		ctan[i][i] += mats.mu[mat];
 
-			for (int i = 3; i < 6; i++)
-				ctan[i][i] += material.mu;
+	for (int i = 0; i < npe * dim * npe * dim; i++)
+		Ae[i] = 0.0;
 
-		}
+	for (int gp = 0; gp < 8; gp++) {
 
 		double bmat[6][3 * 8], cxb[6][3 * 8];
 		calc_bmat_3D(gp, bmat);
@@ -534,25 +537,22 @@ void micropp_t::get_ctan_plast_sec(int ex, int ey, int ez, int gp, double ctan[6
 void micropp_t::get_ctan_plast_exact(int ex, int ey, int ez, int gp, double ctan[6][6])
 {
 	double strain[6];
-	int e = glo_elem3D(ex, ey, ez);
+	const int m = elem_mat[glo_elem3D(ex, ey, ez)];
 	get_strain3D(ex, ey, ez, gp, strain);
 
-	material_t material;
-	get_material(e, material);
-
 	for (int i = 0; i < 6; i++)
 		for (int j = 0; j < 6; j++)
 			ctan[i][j] = 0.0;
 
 	for (int i = 0; i < 3; i++)
 		for (int j = 0; j < 3; j++)
-			ctan[i][j] += material.lambda;
+			ctan[i][j] += mats.lambda[m];
 
 	for (int i = 0; i < 3; i++)
-		ctan[i][i] += 2 * material.mu;
+		ctan[i][i] += 2 * mats.mu[m];
 
 	for (int i = 3; i < 6; i++)
-		ctan[i][i] += material.mu;
+		ctan[i][i] += mats.mu[m];
 
 	//  double theta_1 = 1 - 2*material.mu*dl / sig_dev_trial_norm;
 	//  double theta_2 = 1 / (1 + material.Ka) - (1 - theta_1);
@@ -700,28 +700,27 @@ void micropp_t::get_elem_rhs2D(int ex, int ey, bool *non_linear, double (&be)[2
 
 void micropp_t::get_elem_rhs3D(int ex, int ey, int ez, bool * non_linear, double (&be)[3 * 8])
 {
-	double bmat[6][3 * 8], cxb[6][3 * 8], stress_gp[6];
+	double bmat[6][3 * 8], strain[6][8], stress[6][8];
 
 	for (int i = 0; i < 3 * 8; i++)
 		be[i] = 0.0;
 
+	get_elem_strain3D(ex, ey, ez, strain);
+	get_elem_stress3D(ex, ey, ez, strain, non_linear, stress);
+
 	for (int gp = 0; gp < 8; gp++) {
 
 		calc_bmat_3D(gp, bmat);
 
-		double strain_gp[6];
-		get_strain3D(ex, ey, ez, gp, strain_gp);
-		get_stress3D(ex, ey, ez, gp, strain_gp, non_linear, stress_gp);
-
 		double wg = (1 / 8.0) * dx * dy * dz;
 		for (int i = 0; i < npe * dim; i++)
 			for (int j = 0; j < nvoi; j++)
-				be[i] += bmat[j][i] * stress_gp[j] * wg;
+				be[i] += bmat[j][i] * stress[j][gp] * wg;
 
 	}			// gp loop
 }
 
-void micropp_t::calc_ave_stress(double stress_ave[6])
+void micropp_t::calc_ave_stress(double stress_ave[6], double *ip_vals)
 {
 	bool non_linear_flag;
 
@@ -748,6 +747,13 @@ void micropp_t::calc_ave_stress(double stress_ave[6])
 					for (int v = 0; v < nvoi; v++)
 						stress_aux[v] += stress_gp[v] * wg;
 
+					if (ip_vals != NULL) {
+						double *ip = &ip_vals[(glo_elem3D(ex, ey, 0) * 4 + gp) * (nvoi + 1)];
+						for (int v = 0; v < nvoi; v++)
+							ip[v] = stress_gp[v];
+						ip[nvoi] = 0.0;
+					}
+
 				}
 				for (int v = 0; v < nvoi; v++)
 					stress_ave[v] += stress_aux[v];
@@ -764,16 +770,26 @@ void micropp_t::calc_ave_stress(double stress_ave[6])
 					for (int i = 0; i < nvoi; i++)
 						stress_aux[i] = 0.0;
 
+					double strain[6][8], stress[6][8];
+					get_elem_strain3D(ex, ey, ez, strain);
+					get_elem_stress3D(ex, ey, ez, strain, &non_linear_flag, stress);
+
 					for (int gp = 0; gp < 8; gp++) {
 
-						double stress_gp[6];
 						double wg = (1 / 8.0) * dx * dy * dz;
 
-						double strain_gp[6];
-						get_strain3D(ex, ey, ez, gp, strain_gp);
-						get_stress3D(ex, ey, ez, gp, strain_gp, &non_linear_flag, stress_gp);
 						for (int v = 0; v < nvoi; v++)
-							stress_aux[v] += stress_gp[v] * wg;
+							stress_aux[v] += stress[v][gp] * wg;
+
+						if (ip_vals != NULL) {
+							// Stress and alpha for the in-situ statistics
+							const int e = glo_elem3D(ex, ey, ez);
+							double *ip = &ip_vals[(e * 8 + gp) * (nvoi + 1)];
+							for (int v = 0; v < nvoi; v++)
+								ip[v] = stress[v][gp];
+							ip[nvoi] = mats.plasticity[elem_mat[e]] ?
+								vars_new[intvar_ix(e, gp, 6)] : 0.0;
+						}
 
 					}
 					for (int v = 0; v < nvoi; v++)
@@ -894,16 +910,17 @@ void micropp_t::calc_fields()
 						stress_aux[i] = 0.0;
 					}
 
+					double strain[6][8], stress[6][8];
+					get_elem_strain3D(ex, ey, ez, strain);
+					get_elem_stress3D(ex, ey, ez, strain, &non_linear_flag, stress);
+
 					for (int gp = 0; gp < 8; gp++) {
 
-						double stress_gp[6], strain_gp[6];
 						double wg = (1 / 8.0) * dx * dy * dz;
 
-						get_strain3D(ex, ey, ez, gp, strain_gp);
-						get_stress3D(ex, ey, ez, gp, strain_gp, &non_linear_flag, stress_gp);
 						for (int v = 0; v < nvoi; v++) {
-							strain_aux[v] += strain_gp[v] * wg;
-							stress_aux[v] += stress_gp[v] * wg;
+							strain_aux[v] += strain[v][gp] * wg;
+							stress_aux[v] += stress[v][gp] * wg;
 						}
 
 					}
@@ -929,14 +946,11 @@ void micropp_t::get_stress2D(int ex, int ey, int gp, double strain_gp[3], bool *
 	double ctan[3][3];
 	bool plasticity;
 
-	int e = glo_elem3D(ex, ey, 0);
-
-	material_t material;
-	get_material(e, material);
+	const int m = elem_mat[glo_elem3D(ex, ey, 0)];
 
-	E = material.E;
-	nu = material.nu;
-	plasticity = material.plasticity;
+	E = mats.E[m];
+	nu = mats.nu[m];
+	plasticity = mats.plasticity[m];
 
 	ctan[0][0] = (1 - nu);
 	ctan[0][1] = nu;
@@ -975,17 +989,16 @@ void micropp_t::get_stress3D(int ex, int ey, int ez, int gp, double eps[6],
 	*non_linear = false;
 
 	double ctan[6][6];
-	int e = glo_elem3D(ex, ey, ez);
-	material_t material;
-	get_material(e, material);
+	const int e = glo_elem3D(ex, ey, ez);
+	const int m = elem_mat[e];
 
-	if (material.plasticity == true) {
+	if (mats.plasticity[m] == true) {
 		double alpha_old, alpha_new, eps_p_old[6], eps_p_new[6];
 		for (int i = 0; i < 6; ++i)
 			eps_p_old[i] = vars_old[intvar_ix(e, gp, i)];
 		alpha_old = vars_old[intvar_ix(e, gp, 6)];
 
-		plastic_step(&material, eps, eps_p_old, alpha_old, eps_p_new,
+		plastic_step(m, eps, eps_p_old, alpha_old, eps_p_new,
 		             &alpha_new, non_linear, stress_gp);
 
 		for (int i = 0; i < 6; ++i)
@@ -995,20 +1008,22 @@ void micropp_t::get_stress3D(int ex, int ey, int ez, int gp, double eps[6],
 	} else {
 
 		for (int i = 0; i < 3; ++i) {
-			stress_gp[i] = material.lambda * (eps[0] + eps[1] + eps[2]);
-			stress_gp[i] += 2 * material.mu * eps[i];
+			stress_gp[i] = mats.lambda[m] * (eps[0] + eps[1] + eps[2]);
+			stress_gp[i] += 2 * mats.mu[m] * eps[i];
 		}
 		for (int i = 3; i < 6; ++i)
-			stress_gp[i] = material.mu * eps[i];
+			stress_gp[i] = mats.mu[m] * eps[i];
 	}
 
 }
 
-void micropp_t::plastic_step(material_t *material, double eps[6],
+void micropp_t::plastic_step(const int mat, double eps[6],
                              double eps_p_old[6], double alpha_old,
                              double eps_p_new[6], double *alpha_new,
                              bool *non_linear, double stress[6])
 {
+	const double mu = mats.mu[mat], k = mats.k[mat];
+	const double Sy = mats.Sy[mat], Ka = mats.Ka[mat];
 	double eps_dev[6];
 	double eps_p_dev_1[6];
 	double normal[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
@@ -1019,10 +1034,10 @@ void micropp_t::plastic_step(material_t *material, double eps[6],
 	get_dev_tensor(eps, eps_dev);
 
 	for (int i = 0; i < 3; ++i)
-		sig_dev_trial[i] = 2 * material->mu * (eps_dev[i] - eps_p_dev_1[i]);
+		sig_dev_trial[i] = 2 * mu * (eps_dev[i] - eps_p_dev_1[i]);
 
 	for (int i = 3; i < 6; ++i)
-		sig_dev_trial[i] = material->mu * (eps_dev[i] - eps_p_dev_1[i]);
+		sig_dev_trial[i] = mu * (eps_dev[i] - eps_p_dev_1[i]);
 
 	sig_dev_trial_norm = sqrt(sig_dev_trial[0] * sig_dev_trial[0] +
 	                          sig_dev_trial[1] * sig_dev_trial[1] +
@@ -1031,7 +1046,7 @@ void micropp_t::plastic_step(material_t *material, double eps[6],
 	                          2 * sig_dev_trial[4] * sig_dev_trial[4] +
 	                          2 * sig_dev_trial[5] * sig_dev_trial[5]);
 
-	double f_trial = sig_dev_trial_norm - sqrt(2.0 / 3) * (material->Sy + material->Ka * alpha_old);
+	double f_trial = sig_dev_trial_norm - sqrt(2.0 / 3) * (Sy + Ka * alpha_old);
 
 	if (f_trial > 0) {
 		*non_linear = true;
@@ -1039,7 +1054,7 @@ void micropp_t::plastic_step(material_t *material, double eps[6],
 		for (int i = 0; i < 6; ++i)
 			normal[i] = sig_dev_trial[i] / sig_dev_trial_norm;
 
-		dl = f_trial / (2 * material->mu * (1.0 + (0.0 * material->Ka) / (3 * material->mu)));
+		dl = f_trial / (2 * mu * (1.0 + (0.0 * Ka) / (3 * mu)));
 
 		for (int i = 0; i < 6; ++i)
 			eps_p_new[i] = eps_p_old[i] + dl * normal[i];
@@ -1055,35 +1070,10 @@ void micropp_t::plastic_step(material_t *material, double eps[6],
 		stress[i] = sig_dev_trial[i];
 
 	for (int i = 0; i < 3; ++i)
-		stress[i] += material->k * (eps[0] + eps[1] + eps[2]);
+		stress[i] += k * (eps[0] + eps[1] + eps[2]);
 
 	for (int i = 0; i < 6; ++i)
-		stress[i] -= 2 * material->mu * dl * normal[i];
-}
-
-void micropp_t::get_material(int e, material_t & material)
-{
-	int mat_num;
-	if (micro_type == 0)
-		if (elem_type[e] == 0)
-			mat_num = 0;
-		else
-			mat_num = 1;
-
-	else if (micro_type == 1)
-		if (elem_type[e] == 0)
-			mat_num = 0;
-		else
-			mat_num = 1;
-
-	material.E = material_list[mat_num].E;
-	material.nu = material_list[mat_num].nu;
-	material.Sy = material_list[mat_num].Sy;
-	material.Ka = material_list[mat_num].Ka;
-	material.mu = material_list[mat_num].mu;
-	material.k = material_list[mat_num].k;
-	material.lambda = material_list[mat_num].lambda;
-	material.plasticity = material_list[mat_num].plasticity;
+		stress[i] -= 2 * mu * dl * normal[i];
 }
 
 void micropp_t::get_strain2D(int ex, int ey, int gp, double *strain_gp)
@@ -1143,6 +1133,22 @@ void micropp_t::get_strain3D(int ex, int ey, int ez, int gp, double *strain_gp)
 
 }
 
+void micropp_t::get_elem_strain3D(int ex, int ey, int ez, double strain[6][8])
+{
+	double elem_disp[3 * 8];
+	getElemDisp(ex, ey, ez, elem_disp);
+
+	double bmat[6][3 * 8];
+	for (int gp = 0; gp < 8; gp++) {
+		calc_bmat_3D(gp, bmat);
+		for (int v = 0; v < nvoi; v++) {
+			strain[v][gp] = 0.0;
+			for (int i = 0; i < npe * dim; i++)
+				strain[v][gp] += bmat[v][i] * elem_disp[i];
+		}
+	}
+}
+
 void micropp_t::getElemDisp(int ex, int ey, double *elem_disp)
 {
 	int n0 = ey * nx + ex;
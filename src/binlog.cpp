@@ -0,0 +1,160 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Columnar binary log. prefix.hdr (native byte order) is
+ *
+ *     char magic[8] = LOG_MAGIC, int32 version, nvoi, ngp, ncols,
+ *     num_int_vars, vars_every,
+ *     ncols x { char name[16], int32 type (LOG_INT32/LOG_FLOAT64), width },
+ *     int32 gp_id[ngp]
+ *
+ * and column c is prefix_<name>.bin with nsteps x ngp x width values.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include "micro.hpp"
+
+#define LOG_MAGIC   "MICROPPL"
+#define LOG_VERSION 1
+#define LOG_INT32   0
+#define LOG_FLOAT64 1
+#define LOG_NCOLS   7
+#define LOG_BUFSIZE (1 << 20)
+
+static const char *log_names[LOG_NCOLS] = {
+	"nl_flag", "inv_max", "nr_its", "nr_err", "strain", "stress", "ctan" };
+static const int log_types[LOG_NCOLS] = {
+	LOG_INT32, LOG_FLOAT64, LOG_INT32, LOG_FLOAT64, LOG_FLOAT64, LOG_FLOAT64, LOG_FLOAT64 };
+
+bool micropp_t::open_log(const char *prefix, const int vars_every)
+{
+	assert(vars_every >= 0);
+	close_log();
+
+	log_prefix = prefix;
+	for (int c = 0; c <= LOG_NCOLS; ++c) {
+		const string name = log_prefix + "_" +
+			((c < LOG_NCOLS) ? log_names[c] : "int_vars") + ".bin";
+		FILE *file = fopen(name.c_str(), "wb");
+		if (file == NULL) {
+			cerr << "micropp : can not open " << name << endl;
+			close_log();
+			return false;
+		}
+		setvbuf(file, NULL, _IOFBF, LOG_BUFSIZE);
+		log_files.push_back(file);
+	}
+
+	log_on = true;
+	log_vars_every = vars_every;
+	log_step = 0;
+	log_ngp = 0;
+	return true;
+}
+
+void micropp_t::close_log()
+{
+	io_flush();
+	for (auto file : log_files)
+		fclose(file);
+	log_files.clear();
+	log_on = false;
+}
+
+void micropp_t::write_log()
+{
+	if (!log_on)
+		return;
+
+	if (log_step == 0) {
+		log_ngp = gauss_list.size();
+	} else if (log_ngp != (int) gauss_list.size()) {
+		cerr << "micropp : the number of points changed, the log is not written" << endl;
+		return;
+	}
+
+	const bool vars = (log_vars_every > 0 && log_step % log_vars_every == 0);
+	shared_ptr<info_snapshot_t> snap = make_shared<info_snapshot_t>();
+	take_info_snapshot(*snap, vars ? INFO_VARS_NL : INFO_VARS_NONE);
+
+	const int step = log_step++;
+	io_submit([this, snap, step] { write_log_snapshot(*snap, step); });
+}
+
+void micropp_t::write_log_snapshot(const info_snapshot_t &snap, const int step)
+{
+	const int ngp = snap.ngp;
+	const int width[LOG_NCOLS] = { 1, 1, 1 + nvoi, 1 + nvoi, nvoi, nvoi, nvoi * nvoi };
+
+	if (step == 0) {
+		FILE *file = fopen((log_prefix + ".hdr").c_str(), "wb");
+		if (file == NULL) {
+			cerr << "micropp : can not open " << log_prefix << ".hdr" << endl;
+			return;
+		}
+		const int32_t head[6] = { LOG_VERSION, nvoi, ngp, LOG_NCOLS,
+		                          num_int_vars, log_vars_every };
+		fwrite(LOG_MAGIC, 1, 8, file);
+		fwrite(head, sizeof(int32_t), 6, file);
+		for (int c = 0; c < LOG_NCOLS; ++c) {
+			char name[16];
+			memset(name, 0, sizeof(name));
+			strncpy(name, log_names[c], sizeof(name) - 1);
+			const int32_t desc[2] = { log_types[c], width[c] };
+			fwrite(name, 1, sizeof(name), file);
+			fwrite(desc, sizeof(int32_t), 2, file);
+		}
+		fwrite(snap.id.data(), sizeof(int32_t), ngp, file);
+		fclose(file);
+	}
+
+	vector<int32_t> col_i;
+	vector<double> col_d;
+	for (int c = 0; c < LOG_NCOLS; ++c) {
+		const int w = width[c];
+		if (log_types[c] == LOG_INT32) {
+			col_i.resize(ngp * w);
+			for (int p = 0; p < ngp; ++p)
+				for (int i = 0; i < w; ++i)
+					col_i[p * w + i] = (c == 0) ? snap.nl_flag[p] : snap.nr_its[p * 7 + i];
+			fwrite(col_i.data(), sizeof(int32_t), col_i.size(), log_files[c]);
+		} else if (c == 1 || c == 3) {
+			col_d.resize(ngp * w);
+			for (int p = 0; p < ngp; ++p)
+				for (int i = 0; i < w; ++i)
+					col_d[p * w + i] = (c == 1) ? snap.inv_max[p] : snap.nr_err[p * 7 + i];
+			fwrite(col_d.data(), sizeof(double), col_d.size(), log_files[c]);
+		} else {
+			const vector<double> &col = (c == 4) ? snap.strain :
+				(c == 5) ? snap.stress : snap.ctan;
+			fwrite(col.data(), sizeof(double), col.size(), log_files[c]);
+		}
+	}
+
+	FILE *file = log_files[LOG_NCOLS];
+	for (size_t r = 0; r < snap.vars_ix.size(); ++r) {
+		const int32_t rec[2] = { step, snap.id[snap.vars_ix[r]] };
+		fwrite(rec, sizeof(int32_t), 2, file);
+		fwrite(&snap.int_vars[r * num_int_vars], sizeof(double), num_int_vars, file);
+	}
+}
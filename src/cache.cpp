@@ -0,0 +1,211 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+#include "micro.hpp"
+
+void micropp_t::set_cache(const bool on, const double tol, const int max_entries)
+{
+	if (on && comp_on) {
+		cerr << "micropp : the cache can not be used with compression" << endl;
+		return;
+	}
+
+	cache_clear();
+	cache_on = on;
+	cache_tol = tol;
+	cache_max = max_entries;
+
+	// The fingerprints are only kept up to date while the cache is on
+	for (auto &gp : gauss_list)
+		gp.fingerprint = (gp.int_vars_n == NULL) ? 0 : get_fingerprint(gp.int_vars_n);
+}
+
+void micropp_t::get_cache_stats(long *hits, long *near_hits, long *misses)
+{
+	*hits = cache_hits;
+	*near_hits = cache_near_hits;
+	*misses = cache_misses;
+}
+
+void micropp_t::cache_clear()
+{
+	for (auto &entry : cache_list) {
+		free_int_vars(entry.int_vars_n);
+		free_int_vars(entry.int_vars);
+	}
+	cache_list.clear();
+	cache_map.clear();
+	cache_next = 0;
+	cache_hits = cache_near_hits = cache_misses = 0;
+}
+
+uint64_t micropp_t::get_fingerprint(const double *int_vars)
+{
+	// FNV-1a like hash over 64 bit words, all zero states map to 0
+	uint64_t hash = 14695981039346656037ULL;
+	bool zero = true;
+	for (int i = 0; i < num_int_vars; ++i) {
+		uint64_t word;
+		memcpy(&word, &int_vars[i], sizeof(word));
+		zero = zero && (int_vars[i] == 0.0);
+		hash = (hash ^ word) * 1099511628211ULL;
+	}
+	hash ^= hash >> 33;
+
+	if (zero)
+		return 0;
+	return (hash == 0) ? 1 : hash;
+}
+
+bool micropp_t::cache_lookup(gp_t &gp)
+{
+	unordered_map<uint64_t, vector<int>>::const_iterator it = cache_map.find(gp.fingerprint);
+	if (it == cache_map.end()) {
+		cache_misses++;
+		return false;
+	}
+
+	// Equal fingerprints are only a hint, the states are compared in full
+	int best = -1;
+	double best_dist = cache_tol;
+	for (int c : it->second) {
+		const cache_entry_t &entry = cache_list[c];
+		if (entry.int_vars_n != NULL &&
+		    memcmp(entry.int_vars_n, gp.int_vars_n, num_int_vars * sizeof(double)) != 0)
+			continue;
+
+		double dist = 0.0;
+		for (int i = 0; i < nvoi; ++i)
+			dist += (gp.macro_strain[i] - entry.strain[i]) *
+				(gp.macro_strain[i] - entry.strain[i]);
+		dist = sqrt(dist);
+		if (dist == 0.0 || dist < best_dist) {
+			best = c;
+			best_dist = dist;
+			if (dist == 0.0)
+				break;
+		}
+	}
+
+	if (best < 0) {
+		cache_misses++;
+		return false;
+	}
+
+	const cache_entry_t &entry = cache_list[best];
+	if (best_dist == 0.0) {
+		cache_hits++;
+		for (int i = 0; i < nvoi; ++i)
+			gp.macro_stress[i] = entry.stress[i];
+	} else {
+		// S = S_c + C_c : (E - E_c)
+		cache_near_hits++;
+		for (int i = 0; i < nvoi; ++i) {
+			gp.macro_stress[i] = entry.stress[i];
+			for (int j = 0; j < nvoi; ++j)
+				gp.macro_stress[i] += entry.ctan[i * nvoi + j] *
+					(gp.macro_strain[j] - entry.strain[j]);
+		}
+	}
+	for (int i = 0; i < nvoi * nvoi; ++i)
+		gp.macro_ctan[i] = entry.ctan[i];
+
+	if (entry.int_vars != NULL) {
+		if (gp.int_vars_n == NULL) {
+			gp.int_vars_k = alloc_int_vars(false);
+			gp.int_vars_n = alloc_int_vars(true);
+		} else if (gp.int_vars_k == NULL) {
+			gp.int_vars_k = alloc_int_vars(false);
+		} else {
+			unshare_int_vars_k(gp);
+		}
+		memcpy(gp.int_vars_k, entry.int_vars, num_int_vars * sizeof(double));
+		gp.version = vars_version;
+	} else {
+		reset_int_vars_k(gp);
+	}
+
+	for (int i = 0; i < (1 + nvoi); ++i) {
+		gp.nr_its[i] = 0;
+		gp.nr_err[i] = 0.0;
+	}
+	return true;
+}
+
+void micropp_t::cache_insert(const gp_t &gp, const bool nl_flag)
+{
+	if (cache_max <= 0)
+		return;
+
+	int c;
+	if ((int) cache_list.size() < cache_max) {
+		c = cache_list.size();
+		cache_entry_t entry;
+		entry.int_vars_n = NULL;
+		entry.int_vars = NULL;
+		cache_list.push_back(entry);
+	} else {
+		// Replace the oldest entry
+		c = cache_next;
+		cache_next = (cache_next + 1) % cache_max;
+		vector<int> &bucket = cache_map[cache_list[c].fingerprint];
+		for (size_t i = 0; i < bucket.size(); ++i)
+			if (bucket[i] == c) {
+				bucket[i] = bucket.back();
+				bucket.pop_back();
+				break;
+			}
+		if (bucket.empty())
+			cache_map.erase(cache_list[c].fingerprint);
+	}
+
+	cache_entry_t &entry = cache_list[c];
+	entry.fingerprint = gp.fingerprint;
+	for (int i = 0; i < nvoi; ++i) {
+		entry.strain[i] = gp.macro_strain[i];
+		entry.stress[i] = gp.macro_stress[i];
+	}
+	for (int i = 0; i < nvoi * nvoi; ++i)
+		entry.ctan[i] = gp.macro_ctan[i];
+
+	if (gp.fingerprint != 0) {
+		if (entry.int_vars_n == NULL)
+			entry.int_vars_n = alloc_int_vars(false);
+		memcpy(entry.int_vars_n, gp.int_vars_n, num_int_vars * sizeof(double));
+	} else {
+		free_int_vars(entry.int_vars_n);
+		entry.int_vars_n = NULL;
+	}
+
+	if (nl_flag) {
+		if (entry.int_vars == NULL)
+			entry.int_vars = alloc_int_vars(false);
+		memcpy(entry.int_vars, gp.int_vars_k, num_int_vars * sizeof(double));
+	} else {
+		free_int_vars(entry.int_vars);
+		entry.int_vars = NULL;
+	}
+
+	cache_map[entry.fingerprint].push_back(c);
+}
@@ -0,0 +1,286 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checkpoint of the committed state of the points (native byte order)
+ *
+ *     ckpt_header_t
+ *     int64 vars_row[ngp]		row of the int_vars_n or -1
+ *     double strain[ngp * nvoi], stress[ngp * nvoi], ctan[ngp * nvoi * nvoi]
+ *     int32 gp_id[ngp]
+ *     (padding to vars_offset, page aligned)
+ *     nvars rows of num_int_vars doubles every block_size bytes
+ *
+ * The rows have the stride of the int_vars arena, so that a restore maps
+ * them copy on write as arena blocks and every point reads its state on
+ * first touch. The restored points have no int_vars_k until their first
+ * trial, which copies the row (with deduplication the rows are hashed at
+ * the restore).
+ */
+
+#include <cstring>
+#include <cassert>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "micro.hpp"
+
+#define CKPT_MAGIC   "MICROPPC"
+#define CKPT_VERSION 2		// the int_vars are stored by variable since 2
+#define CKPT_ALIGN   64		// stride of the int_vars arena blocks
+#define CKPT_PAGE    4096
+#define CKPT_THREADS 4
+
+struct ckpt_header_t {
+	char magic[8];
+	int32_t version;
+	int32_t nvoi;
+	int32_t size[3];
+	int32_t micro_type;
+	int32_t num_int_vars;
+	int32_t block_size;
+	uint64_t ngp;
+	uint64_t nvars;
+	uint64_t vars_offset;
+	double ctan_lin[36];
+};
+
+struct ckpt_snapshot_t {
+	ckpt_header_t header;
+	vector<int64_t> vars_row;
+	vector<double> strain, stress, ctan;
+	vector<int32_t> id;
+	vector<char> vars;		// (nvars * block_size)
+};
+
+static bool ckpt_pwrite(const int fd, const char *buf, size_t bytes, off_t offset)
+{
+	while (bytes > 0) {
+		const ssize_t n = pwrite(fd, buf, bytes, offset);
+		if (n <= 0)
+			return false;
+		buf += n;
+		bytes -= n;
+		offset += n;
+	}
+	return true;
+}
+
+static void ckpt_write(const ckpt_snapshot_t &snap, const string &fname)
+{
+	// Written to fname.tmp and renamed, a crash never leaves half a
+	// checkpoint behind
+	const string tmp = fname + ".tmp";
+	const int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		cerr << "micropp : can not open " << tmp << endl;
+		return;
+	}
+
+	const uint64_t ngp = snap.header.ngp;
+	struct piece_t { const char *buf; size_t bytes; off_t offset; };
+	vector<piece_t> pieces;
+	off_t offset = 0;
+	auto add = [&pieces, &offset](const void *buf, const size_t bytes) {
+		pieces.push_back({ (const char *) buf, bytes, offset });
+		offset += bytes;
+	};
+	add(&snap.header, sizeof(ckpt_header_t));
+	add(snap.vars_row.data(), ngp * sizeof(int64_t));
+	add(snap.strain.data(), snap.strain.size() * sizeof(double));
+	add(snap.stress.data(), snap.stress.size() * sizeof(double));
+	add(snap.ctan.data(), snap.ctan.size() * sizeof(double));
+	add(snap.id.data(), ngp * sizeof(int32_t));
+
+	// The int_vars are split between the threads
+	offset = snap.header.vars_offset;
+	const size_t part = (snap.vars.size() / CKPT_THREADS + CKPT_PAGE - 1) / CKPT_PAGE * CKPT_PAGE;
+	for (size_t start = 0; start < snap.vars.size(); start += part)
+		add(&snap.vars[start], min(part, snap.vars.size() - start));
+
+	bool ok = (ftruncate(fd, offset) == 0);
+	vector<std::thread> threads;
+	vector<char> thr_ok(CKPT_THREADS, 1);
+	for (int t = 0; t < CKPT_THREADS; ++t)
+		threads.push_back(std::thread([&, t] {
+			for (size_t i = t; i < pieces.size(); i += CKPT_THREADS)
+				if (!ckpt_pwrite(fd, pieces[i].buf, pieces[i].bytes, pieces[i].offset))
+					thr_ok[t] = 0;
+		}));
+	for (auto &thr : threads)
+		thr.join();
+	for (int t = 0; t < CKPT_THREADS; ++t)
+		ok = ok && thr_ok[t];
+
+	ok = (close(fd) == 0) && ok;
+	if (!ok || rename(tmp.c_str(), fname.c_str()) != 0) {
+		cerr << "micropp : can not write " << fname << endl;
+		unlink(tmp.c_str());
+	}
+}
+
+void micropp_t::write_checkpoint(const char *fname)
+{
+	shared_ptr<ckpt_snapshot_t> snap = make_shared<ckpt_snapshot_t>();
+	const uint64_t ngp = gauss_list.size();
+	const size_t block_size = (num_int_vars * sizeof(double) + CKPT_ALIGN - 1) /
+		CKPT_ALIGN * CKPT_ALIGN;
+
+	ckpt_header_t &h = snap->header;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CKPT_MAGIC, 8);
+	h.version = CKPT_VERSION;
+	h.nvoi = nvoi;
+	h.size[0] = nx;
+	h.size[1] = ny;
+	h.size[2] = nz;
+	h.micro_type = micro_type;
+	h.num_int_vars = num_int_vars;
+	h.block_size = block_size;
+	h.ngp = ngp;
+	memcpy(h.ctan_lin, ctan_lin, sizeof(ctan_lin));
+
+	snap->vars_row.resize(ngp);
+	snap->id.resize(ngp);
+	snap->strain.assign(gp_strain, gp_strain + ngp * nvoi);
+	snap->stress.assign(gp_stress, gp_stress + ngp * nvoi);
+	snap->ctan.resize(ngp * nvoi * nvoi);
+	for (uint64_t p = 0; p < ngp; ++p) {
+		const gp_t &gp = gauss_list[p];
+		snap->id[p] = gp.id;
+		memcpy(&snap->ctan[p * nvoi * nvoi], gp.macro_ctan, nvoi * nvoi * sizeof(double));
+		snap->vars_row[p] = (gp.int_vars_n != NULL || gp.int_vars_c != NULL) ? h.nvars++ : -1;
+	}
+
+	const size_t meta = sizeof(ckpt_header_t) + ngp * (sizeof(int64_t) + sizeof(int32_t) +
+	                    (2 * nvoi + nvoi * nvoi) * sizeof(double));
+	h.vars_offset = (meta + CKPT_PAGE - 1) / CKPT_PAGE * CKPT_PAGE;
+
+	snap->vars.assign(h.nvars * block_size, 0);
+	for (uint64_t p = 0; p < ngp; ++p)
+		if (snap->vars_row[p] >= 0)
+			load_int_vars_n(gauss_list[p],
+			                (double *) &snap->vars[snap->vars_row[p] * block_size]);
+
+	const string name = fname;
+	io_submit([snap, name] { ckpt_write(*snap, name); });
+}
+
+bool micropp_t::load_checkpoint(const char *fname)
+{
+	io_flush();
+
+	int fd = open(fname, O_RDONLY);
+	if (fd < 0) {
+		cerr << "micropp : can not open " << fname << endl;
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(ckpt_header_t)) {
+		cerr << "micropp : " << fname << " is not a checkpoint" << endl;
+		close(fd);
+		return false;
+	}
+
+	const char *map = (const char *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		cerr << "micropp : can not map " << fname << endl;
+		close(fd);
+		return false;
+	}
+
+	const ckpt_header_t *h = (const ckpt_header_t *) map;
+	if (memcmp(h->magic, CKPT_MAGIC, 8) != 0 || h->version != CKPT_VERSION ||
+	    h->nvoi != nvoi || h->size[0] != nx || h->size[1] != ny || h->size[2] != nz ||
+	    h->micro_type != micro_type || h->num_int_vars != num_int_vars ||
+	    h->vars_offset < sizeof(ckpt_header_t) + h->ngp * (sizeof(int64_t) + sizeof(int32_t) +
+	                     (2 * nvoi + nvoi * nvoi) * sizeof(double)) ||
+	    (uint64_t) st.st_size < h->vars_offset + h->nvars * h->block_size) {
+		cerr << "micropp : " << fname << " does not match this micro-structure" << endl;
+		munmap((void *) map, st.st_size);
+		close(fd);
+		return false;
+	}
+
+	const uint64_t ngp = h->ngp;
+	const int64_t *vars_row = (const int64_t *) (h + 1);
+	const double *strain = (const double *) (vars_row + ngp);
+	const double *stress = strain + ngp * nvoi;
+	const double *ctan = stress + ngp * nvoi;
+	const int32_t *id = (const int32_t *) (ctan + ngp * nvoi * nvoi);
+	const char *vars = map + h->vars_offset;
+
+	// The current points are replaced
+	for (auto const &gp : gauss_list) {
+		free_int_vars(gp.int_vars_n);
+		free_int_vars(gp.int_vars_k);
+		free(gp.int_vars_c);
+		spill_forget(gp.id);
+		free(gp.rom_vars_n);
+		free(gp.rom_vars_k);
+		free(gp.table_eps_n);
+		free(gp.table_eps_k);
+	}
+	gauss_list.clear();
+	gauss_map.clear();
+	resize_gp_store(max(ngp, (uint64_t) 1));
+
+	// Without compression nor spill the rows become the int_vars_n
+	char *rows = NULL;
+	if (!comp_on && !spill_on && (size_t) h->block_size == vars_arena.block_size)
+		rows = (char *) arena_map_blocks(&vars_arena, fd, h->vars_offset, h->nvars);
+
+	for (uint64_t p = 0; p < ngp; ++p) {
+		gp_t &gp = gauss_list[add_gp(id[p])];
+		memcpy(gp.macro_strain, &strain[p * nvoi], nvoi * sizeof(double));
+		memcpy(gp.macro_stress, &stress[p * nvoi], nvoi * sizeof(double));
+		memcpy(gp.macro_ctan, &ctan[p * nvoi * nvoi], nvoi * nvoi * sizeof(double));
+
+		if (vars_row[p] < 0)
+			continue;
+
+		const double *row = (const double *) (vars + vars_row[p] * h->block_size);
+		if (comp_on) {
+			gp.int_vars_c_size = compress_vars(row, &gp.int_vars_c);
+		} else if (rows != NULL) {
+			gp.int_vars_n = (double *) (rows + vars_row[p] * h->block_size);
+		} else {
+			gp.int_vars_n = alloc_int_vars(false);
+			memcpy(gp.int_vars_n, row, num_int_vars * sizeof(double));
+		}
+
+		if (!comp_on && dedup_on)
+			gp.int_vars_n = gp.int_vars_k = dedup_commit(gp.int_vars_n);
+		if (cache_on)
+			gp.fingerprint = get_fingerprint(gp.int_vars_n);
+		if (spill_on)
+			spill_touch(gp);
+	}
+
+	memcpy(ctan_lin, h->ctan_lin, sizeof(ctan_lin));
+	munmap((void *) map, st.st_size);
+	close(fd);
+	return true;
+}
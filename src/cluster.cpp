@@ -0,0 +1,551 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Clustering reduced order model of the RVE
+ *
+ * Offline : the elements are grouped (k-means per material) by their
+ * strain concentration tensors under the six unit macro strains. For
+ * every cluster I we keep its volume fraction f_I, its mean
+ * concentration A_I and the interaction tensors D_IJ, the mean strain
+ * in I produced by a unit eigenstrain in J.
+ *
+ * Online : the cluster strains solve
+ *
+ *     eps_I = A_I : E + sum_J D_IJ : eps_p_J(eps_J)
+ *
+ * with Newton iterations, calling plastic_step once per cluster.
+ * The macro stress is sum_I f_I sig_I.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#include "micro.hpp"
+
+#define ROM_KMEANS_ITS 50
+#define ROM_NR_MAX_TOL 1.0e-10
+#define ROM_NR_MAX_ITS 30
+
+void micropp_t::solve_dense(const int n, double *a, double *b)
+{
+	// Gauss elimination with partial pivoting, a is overwritten
+	for (int k = 0; k < n; ++k) {
+		int piv = k;
+		for (int i = k + 1; i < n; ++i)
+			if (fabs(a[i * n + k]) > fabs(a[piv * n + k]))
+				piv = i;
+		if (piv != k) {
+			for (int j = 0; j < n; ++j)
+				swap(a[k * n + j], a[piv * n + j]);
+			swap(b[k], b[piv]);
+		}
+		for (int i = k + 1; i < n; ++i) {
+			const double f = a[i * n + k] / a[k * n + k];
+			if (f == 0.0)
+				continue;
+			for (int j = k; j < n; ++j)
+				a[i * n + j] -= f * a[k * n + j];
+			b[i] -= f * b[k];
+		}
+	}
+	for (int i = n - 1; i >= 0; --i) {
+		for (int j = i + 1; j < n; ++j)
+			b[i] -= a[i * n + j] * b[j];
+		b[i] /= a[i * n + i];
+	}
+}
+
+void micropp_t::calc_elem_strain_ave(double *strain)
+{
+	const double wg = 1 / 8.0;
+	for (int ex = 0; ex < nx - 1; ex++) {
+		for (int ey = 0; ey < ny - 1; ey++) {
+			for (int ez = 0; ez < nz - 1; ez++) {
+				const int e = glo_elem3D(ex, ey, ez);
+				for (int v = 0; v < nvoi; v++)
+					strain[e * nvoi + v] = 0.0;
+				for (int gp = 0; gp < 8; gp++) {
+					double strain_gp[6];
+					get_strain3D(ex, ey, ez, gp, strain_gp);
+					for (int v = 0; v < nvoi; v++)
+						strain[e * nvoi + v] += strain_gp[v] * wg;
+				}
+			}
+		}
+	}
+}
+
+void micropp_t::calc_clusters(const int nclus)
+{
+	assert(dim == 3 && nclus > 0);
+
+	const double d_eps = 1.0e-8;
+	vector<double> conc(nelem * 36);
+	vector<double> strain(nelem * 6);
+
+	// Strain concentration tensors (elastic, from the virgin state)
+	for (int i = 0; i < num_int_vars; ++i)
+		vars_old[i] = 0.0;
+
+	for (int i = 0; i < nvoi; ++i) {
+		double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+		eps[i] = d_eps;
+
+		int nr_its;
+		bool nl_flag;
+		double nr_err;
+		set_displ(eps);
+		newton_raphson(&nl_flag, &nr_its, &nr_err);
+		calc_elem_strain_ave(strain.data());
+
+		for (int e = 0; e < nelem; ++e)
+			for (int v = 0; v < nvoi; ++v)
+				conc[e * 36 + v * 6 + i] = strain[e * 6 + v] / d_eps;
+	}
+
+	// k-means of the concentration tensors inside each material
+	rom_elem_clus.assign(nelem, -1);
+	rom_clus_mat.clear();
+	int nclus_tot = 0;
+
+	for (int mat = 0; mat < numMaterials; ++mat) {
+
+		vector<int> elems;
+		for (int e = 0; e < nelem; ++e)
+			if (elem_mat[e] == mat)
+				elems.push_back(e);
+		if (elems.empty())
+			continue;
+
+		const int k = min(nclus, (int) elems.size());
+
+		// Deterministic seeds : quantiles of the tensor norms
+		vector<pair<double, int>> norms(elems.size());
+		for (int i = 0; i < (int) elems.size(); ++i) {
+			double norm = 0.0;
+			for (int j = 0; j < 36; ++j)
+				norm += conc[elems[i] * 36 + j] * conc[elems[i] * 36 + j];
+			norms[i] = make_pair(norm, elems[i]);
+		}
+		sort(norms.begin(), norms.end());
+
+		vector<double> centers(k * 36);
+		for (int c = 0; c < k; ++c) {
+			const int e = norms[(c * (elems.size() - 1)) / max(k - 1, 1)].second;
+			for (int j = 0; j < 36; ++j)
+				centers[c * 36 + j] = conc[e * 36 + j];
+		}
+
+		vector<int> label(elems.size(), -1);
+		for (int it = 0; it < ROM_KMEANS_ITS; ++it) {
+			bool changed = false;
+			for (int i = 0; i < (int) elems.size(); ++i) {
+				int best = 0;
+				double best_dist = 1.0e300;
+				for (int c = 0; c < k; ++c) {
+					double dist = 0.0;
+					for (int j = 0; j < 36; ++j) {
+						double d = conc[elems[i] * 36 + j] - centers[c * 36 + j];
+						dist += d * d;
+					}
+					if (dist < best_dist) {
+						best_dist = dist;
+						best = c;
+					}
+				}
+				if (label[i] != best) {
+					label[i] = best;
+					changed = true;
+				}
+			}
+			if (!changed)
+				break;
+
+			vector<int> count(k, 0);
+			vector<double> sum(k * 36, 0.0);
+			for (int i = 0; i < (int) elems.size(); ++i) {
+				count[label[i]]++;
+				for (int j = 0; j < 36; ++j)
+					sum[label[i] * 36 + j] += conc[elems[i] * 36 + j];
+			}
+			for (int c = 0; c < k; ++c)
+				if (count[c] > 0)
+					for (int j = 0; j < 36; ++j)
+						centers[c * 36 + j] = sum[c * 36 + j] / count[c];
+		}
+
+		// Global numbering skipping empty clusters
+		vector<int> glo(k, -1);
+		for (int i = 0; i < (int) elems.size(); ++i) {
+			if (glo[label[i]] < 0) {
+				glo[label[i]] = nclus_tot++;
+				rom_clus_mat.push_back(mat);
+			}
+			rom_elem_clus[elems[i]] = glo[label[i]];
+		}
+	}
+
+	const int nc = nclus_tot;
+	rom_nclus = nc;
+
+	// Volume fractions and mean concentration tensors
+	rom_frac.assign(nc, 0.0);
+	rom_A.assign(nc * 36, 0.0);
+	for (int e = 0; e < nelem; ++e) {
+		const int c = rom_elem_clus[e];
+		rom_frac[c] += 1.0;
+		for (int j = 0; j < 36; ++j)
+			rom_A[c * 36 + j] += conc[e * 36 + j];
+	}
+	for (int c = 0; c < nc; ++c) {
+		for (int j = 0; j < 36; ++j)
+			rom_A[c * 36 + j] /= rom_frac[c];
+		rom_frac[c] /= nelem;
+	}
+
+	// Interaction tensors : K u = int_J B^t C eps* with u = 0 on the boundary
+	const int n = 6 * nc;
+	rom_D.assign(n * n, 0.0);
+
+	for (int i = 0; i < nn * dim; ++i)
+		u[i] = 0.0;
+	assembly_mat();
+
+	for (int J = 0; J < nc; ++J) {
+
+		const int m = rom_clus_mat[J];
+		double ctan[6][6];
+		for (int i = 0; i < 6; i++)
+			for (int j = 0; j < 6; j++)
+				ctan[i][j] = 0.0;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				ctan[i][j] += mats.lambda[m];
+		for (int i = 0; i < 3; i++)
+			ctan[i][i] += 2 * mats.mu[m];
+		for (int i = 3; i < 6; i++)
+			ctan[i][i] += mats.mu[m];
+
+		for (int k = 0; k < nvoi; ++k) {
+
+			for (int i = 0; i < nn * dim; ++i)
+				b[i] = 0.0;
+
+			const double wg = (1 / 8.0) * dx * dy * dz;
+			for (int ex = 0; ex < nx - 1; ex++) {
+				for (int ey = 0; ey < ny - 1; ey++) {
+					for (int ez = 0; ez < nz - 1; ez++) {
+						if (rom_elem_clus[glo_elem3D(ex, ey, ez)] != J)
+							continue;
+
+						const int n0 = ez * (nx * ny) + ey * nx + ex;
+						const int nodes[8] = { n0, n0 + 1, n0 + nx + 1, n0 + nx,
+						                       n0 + nx * ny, n0 + nx * ny + 1,
+						                       n0 + nx * ny + nx + 1, n0 + nx * ny + nx };
+
+						for (int gp = 0; gp < 8; ++gp) {
+							double bmat[6][3 * 8];
+							calc_bmat_3D(gp, bmat);
+							for (int a = 0; a < 8; ++a)
+								for (int d = 0; d < dim; ++d)
+									for (int v = 0; v < nvoi; ++v)
+										b[nodes[a] * dim + d] +=
+											bmat[v][a * dim + d] * ctan[v][k] * wg;
+						}
+					}
+				}
+			}
+
+			for (int kz = 0; kz < nz; ++kz)
+				for (int jy = 0; jy < ny; ++jy)
+					for (int ix = 0; ix < nx; ++ix)
+						if (ix == 0 || ix == nx - 1 || jy == 0 || jy == ny - 1 ||
+						    kz == 0 || kz == nz - 1)
+							for (int d = 0; d < dim; ++d)
+								b[(kz * nx * ny + jy * nx + ix) * dim + d] = 0.0;
+
+			for (int i = 0; i < nn * dim; ++i)
+				du[i] = 0.0;
+			solve();
+			for (int i = 0; i < nn * dim; ++i)
+				u[i] = du[i];
+
+			calc_elem_strain_ave(strain.data());
+
+			for (int e = 0; e < nelem; ++e) {
+				const int I = rom_elem_clus[e];
+				for (int v = 0; v < nvoi; ++v)
+					rom_D[(I * 6 + v) * n + J * 6 + k] += strain[e * 6 + v];
+			}
+		}
+	}
+
+	for (int I = 0; I < nc; ++I) {
+		const double nelem_I = rom_frac[I] * nelem;
+		for (int v = 0; v < nvoi; ++v)
+			for (int j = 0; j < n; ++j)
+				rom_D[(I * 6 + v) * n + j] /= nelem_I;
+	}
+
+	for (int i = 0; i < nn * dim; ++i)
+		u[i] = 0.0;
+}
+
+void micropp_t::set_rom(const bool on)
+{
+	assert(!on || rom_nclus > 0);
+	rom_on = on;
+	if (on)
+		pod_on = false;
+}
+
+int micropp_t::get_rom_nvars()
+{
+	return (pod_on ? pod_npts : rom_nclus) * INT_VARS_GP;
+}
+
+void micropp_t::rom_point_stress(const int mat, const double eps[6], const double *vars_n,
+                                 double eps_p[6], double *alpha, bool *non_linear,
+                                 double stress[6])
+{
+	// vars_n : the INT_VARS_GP committed variables of the point or NULL
+	*non_linear = false;
+
+	if (mats.plasticity[mat] == true) {
+		double eps_p_old[6], alpha_old;
+		for (int i = 0; i < 6; ++i)
+			eps_p_old[i] = (vars_n != NULL) ? vars_n[i] : 0.0;
+		alpha_old = (vars_n != NULL) ? vars_n[6] : 0.0;
+
+		plastic_step(mat, (double *) eps, eps_p_old, alpha_old, eps_p,
+		             alpha, non_linear, stress);
+	} else {
+		for (int i = 0; i < 3; ++i) {
+			stress[i] = mats.lambda[mat] * (eps[0] + eps[1] + eps[2]);
+			stress[i] += 2 * mats.mu[mat] * eps[i];
+		}
+		for (int i = 3; i < 6; ++i)
+			stress[i] = mats.mu[mat] * eps[i];
+		for (int i = 0; i < 6; ++i)
+			eps_p[i] = 0.0;
+		*alpha = 0.0;
+	}
+}
+
+void micropp_t::rom_solve(const double *macro_strain, const double *vars_n, double *vars_k,
+                          double *macro_stress, bool *non_linear, int *its, double *err)
+{
+	const int nc = rom_nclus;
+	const int n = 6 * nc;
+	const double d_eps = 1.0e-8;
+
+	vector<double> x(n), ae(n), eps_p(n), r(n), jac(n * n), pmat(n * 6);
+	vector<double> alpha(nc), stress(n);
+
+	double norm_ae = 0.0;
+	for (int I = 0; I < nc; ++I)
+		for (int v = 0; v < 6; ++v) {
+			ae[I * 6 + v] = 0.0;
+			for (int j = 0; j < 6; ++j)
+				ae[I * 6 + v] += rom_A[I * 36 + v * 6 + j] * macro_strain[j];
+			norm_ae += ae[I * 6 + v] * ae[I * 6 + v];
+		}
+	norm_ae = sqrt(norm_ae);
+
+	// Initial guess with the committed plastic strains
+	for (int a = 0; a < n; ++a) {
+		x[a] = ae[a];
+		if (vars_n != NULL)
+			for (int J = 0; J < nc; ++J)
+				for (int k = 0; k < 6; ++k)
+					x[a] += rom_D[a * n + J * 6 + k] * vars_n[J * INT_VARS_GP + k];
+	}
+
+	*its = 0;
+	*err = 0.0;
+	while (true) {
+
+		*non_linear = false;
+		for (int I = 0; I < nc; ++I) {
+			bool nl;
+			rom_point_stress(rom_clus_mat[I], &x[I * 6],
+			                 (vars_n != NULL) ? &vars_n[I * INT_VARS_GP] : NULL,
+			                 &eps_p[I * 6], &alpha[I], &nl, &stress[I * 6]);
+			*non_linear = *non_linear || nl;
+		}
+
+		*err = 0.0;
+		for (int a = 0; a < n; ++a) {
+			r[a] = x[a] - ae[a];
+			for (int b = 0; b < n; ++b)
+				r[a] -= rom_D[a * n + b] * eps_p[b];
+			*err += r[a] * r[a];
+		}
+		*err = sqrt(*err);
+
+		if (*err <= ROM_NR_MAX_TOL * (norm_ae + 1.0e-30) || *its >= ROM_NR_MAX_ITS)
+			break;
+
+		// P_I = d eps_p_I / d eps_I (block diagonal)
+		for (int I = 0; I < nc; ++I) {
+			for (int k = 0; k < 6; ++k) {
+				double x_pert[6], eps_p_pert[6], alpha_pert, stress_pert[6];
+				bool nl;
+				for (int v = 0; v < 6; ++v)
+					x_pert[v] = x[I * 6 + v];
+				x_pert[k] += d_eps;
+				rom_point_stress(rom_clus_mat[I], x_pert,
+				                 (vars_n != NULL) ? &vars_n[I * INT_VARS_GP] : NULL,
+				                 eps_p_pert, &alpha_pert, &nl, stress_pert);
+				for (int v = 0; v < 6; ++v)
+					pmat[(I * 6 + v) * 6 + k] = (eps_p_pert[v] - eps_p[I * 6 + v]) / d_eps;
+			}
+		}
+
+		// J = I - D P
+		for (int a = 0; a < n; ++a) {
+			for (int J = 0; J < nc; ++J) {
+				for (int k = 0; k < 6; ++k) {
+					double sum = 0.0;
+					for (int v = 0; v < 6; ++v)
+						sum += rom_D[a * n + J * 6 + v] * pmat[(J * 6 + v) * 6 + k];
+					jac[a * n + J * 6 + k] = ((a == J * 6 + k) ? 1.0 : 0.0) - sum;
+				}
+			}
+			r[a] = -r[a];
+		}
+
+		solve_dense(n, jac.data(), r.data());
+		for (int a = 0; a < n; ++a)
+			x[a] += r[a];
+		(*its)++;
+	}
+
+	for (int v = 0; v < 6; ++v) {
+		macro_stress[v] = 0.0;
+		for (int I = 0; I < nc; ++I)
+			macro_stress[v] += rom_frac[I] * stress[I * 6 + v];
+	}
+
+	if (vars_k != NULL)
+		for (int I = 0; I < nc; ++I) {
+			for (int v = 0; v < 6; ++v)
+				vars_k[I * INT_VARS_GP + v] = eps_p[I * 6 + v];
+			vars_k[I * INT_VARS_GP + 6] = alpha[I];
+		}
+}
+
+void micropp_t::rom_solve_gp(gp_t &gp)
+{
+	// Solves with the active reduced model
+	// With history the trial state is written straight into rom_vars_k
+	const int nvars = get_rom_nvars();
+	vector<double> vars_k(gp.rom_vars_n == NULL ? nvars : 0);
+	double *vars = (gp.rom_vars_n == NULL) ? vars_k.data() : gp.rom_vars_k;
+
+	int nr_its;
+	bool nl_flag;
+	double nr_err;
+	if (pod_on)
+		pod_solve(gp.macro_strain, gp.rom_vars_n, vars, gp.macro_stress,
+		          &nl_flag, &nr_its, &nr_err);
+	else
+		rom_solve(gp.macro_strain, gp.rom_vars_n, vars, gp.macro_stress,
+		          &nl_flag, &nr_its, &nr_err);
+
+	if (nl_flag == true) {
+		if (gp.rom_vars_n == NULL) {
+			gp.rom_vars_k = (double *) malloc(nvars * sizeof(double));
+			gp.rom_vars_n = (double *) calloc(nvars, sizeof(double));
+			memcpy(gp.rom_vars_k, vars_k.data(), nvars * sizeof(double));
+		}
+		gp.version = vars_version;
+	}
+
+	gp.nr_its[0] = nr_its;
+	gp.nr_err[0] = nr_err;
+
+	double eps_1[6], sig_1[6], dEps = 1.0e-8;
+	for (int i = 0; i < nvoi; ++i) {
+		for (int v = 0; v < nvoi; ++v)
+			eps_1[v] = gp.macro_strain[v];
+		eps_1[i] += dEps;
+
+		if (pod_on)
+			pod_solve(eps_1, gp.rom_vars_n, NULL, sig_1, &nl_flag, &nr_its, &nr_err);
+		else
+			rom_solve(eps_1, gp.rom_vars_n, NULL, sig_1, &nl_flag, &nr_its, &nr_err);
+		for (int v = 0; v < nvoi; ++v)
+			gp.macro_ctan[v * nvoi + i] = (sig_1[v] - gp.macro_stress[v]) / dEps;
+
+		gp.nr_its[1 + i] = nr_its;
+		gp.nr_err[1 + i] = nr_err;
+	}
+}
+
+double micropp_t::get_rom_error(const double *macro_strain)
+{
+	// Relative stress error of the reduced model against a full solve,
+	// both from the virgin state
+	assert(pod_on ? pod_npts > 0 : rom_nclus > 0);
+
+	double strain[6], stress_full[6], stress_rom[6], ctan[36];
+	for (int i = 0; i < nvoi; ++i)
+		strain[i] = macro_strain[i];
+
+	bool cache_on_0 = cache_on, pod_snap_on_0 = pod_snap_on;
+	cache_on = false;
+	pod_snap_on = false;
+
+	gp_t gp;
+	gp.id = -1;
+	gp.int_vars_n = NULL;
+	gp.int_vars_k = NULL;
+	gp.int_vars_c = NULL;
+	gp.rom_vars_n = NULL;
+	gp.rom_vars_k = NULL;
+	gp.version = -1;
+	gp.macro_strain = strain;
+	gp.macro_stress = stress_full;
+	gp.macro_ctan = ctan;
+	solve_gp(gp);
+	free_int_vars(gp.int_vars_n);
+	free_int_vars(gp.int_vars_k);
+
+	gp.int_vars_n = NULL;
+	gp.int_vars_k = NULL;
+	gp.macro_stress = stress_rom;
+	rom_solve_gp(gp);
+	free(gp.rom_vars_n);
+	free(gp.rom_vars_k);
+
+	cache_on = cache_on_0;
+	pod_snap_on = pod_snap_on_0;
+
+	double norm_err = 0.0, norm = 0.0;
+	for (int i = 0; i < nvoi; ++i) {
+		norm_err += (stress_rom[i] - stress_full[i]) * (stress_rom[i] - stress_full[i]);
+		norm += stress_full[i] * stress_full[i];
+	}
+	return sqrt(norm_err / (norm + 1.0e-30));
+}
@@ -0,0 +1,204 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compressed committed internal variables
+ *
+ * The state is stored as one mode byte (and the step 2 tol for the
+ * lossy mode) followed by runs
+ *
+ *     [nzero, nval] (uint32) and the nval values
+ *
+ * The values are doubles, or in the lossy mode the int32 multiples of
+ * 2 tol closest to them (error <= tol). A state that does not fit in
+ * int32 falls back to doubles.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+
+#include "micro.hpp"
+
+#define COMP_DOUBLE 0
+#define COMP_INT32  1
+
+void micropp_t::set_compression(const bool on, const double tol)
+{
+	assert(tol >= 0.0);
+	if (on && (cache_on || sur_on || spill_on || dedup_on)) {
+		cerr << "micropp : compression can not be used with the cache, "
+		     << "the surrogate, the spill or the deduplication" << endl;
+		return;
+	}
+
+	if (on && !comp_on) {
+		for (auto &gp : gauss_list)
+			if (gp.int_vars_n != NULL) {
+				gp.int_vars_c_size = compress_vars(gp.int_vars_n, &gp.int_vars_c);
+				free_int_vars(gp.int_vars_n);
+				free_int_vars(gp.int_vars_k);
+				gp.int_vars_n = NULL;
+				gp.int_vars_k = NULL;
+			}
+	} else if (!on && comp_on) {
+		for (auto &gp : gauss_list)
+			if (gp.int_vars_c != NULL) {
+				gp.int_vars_n = alloc_int_vars(false);
+				decompress_vars(gp.int_vars_c, gp.int_vars_n);
+				if (gp.int_vars_k == NULL) {
+					gp.int_vars_k = alloc_int_vars(false);
+					memcpy(gp.int_vars_k, gp.int_vars_n,
+					       num_int_vars * sizeof(double));
+				}
+				free(gp.int_vars_c);
+				gp.int_vars_c = NULL;
+				gp.int_vars_c_size = 0;
+			}
+	}
+
+	comp_on = on;
+	comp_tol = tol;
+}
+
+void micropp_t::get_compression_stats(size_t *raw, size_t *compressed)
+{
+	*raw = *compressed = 0;
+	for (auto const &gp : gauss_list)
+		if (gp.int_vars_c != NULL) {
+			*raw += num_int_vars * sizeof(double);
+			*compressed += gp.int_vars_c_size;
+		}
+}
+
+size_t micropp_t::compress_vars(const double *vars, unsigned char **buf)
+{
+	const double step = 2.0 * comp_tol;
+
+	unsigned char mode = (comp_tol > 0.0) ? COMP_INT32 : COMP_DOUBLE;
+	if (mode == COMP_INT32)
+		for (int i = 0; i < num_int_vars; ++i)
+			if (fabs(vars[i] / step) >= INT32_MAX) {
+				mode = COMP_DOUBLE;
+				break;
+			}
+
+	const size_t val_size = (mode == COMP_INT32) ? sizeof(int32_t) : sizeof(double);
+
+	// Values that are stored as zeros
+	vector<int32_t> q;
+	if (mode == COMP_INT32) {
+		q.resize(num_int_vars);
+		for (int i = 0; i < num_int_vars; ++i)
+			q[i] = (int32_t) lround(vars[i] / step);
+	}
+	auto is_zero = [&](int i) { return (mode == COMP_INT32) ? q[i] == 0 : vars[i] == 0.0; };
+
+	// Size
+	size_t size = 1 + ((mode == COMP_INT32) ? sizeof(double) : 0);
+	int i = 0;
+	while (i < num_int_vars) {
+		while (i < num_int_vars && is_zero(i))
+			i++;
+		int nval = 0;
+		while (i < num_int_vars && !is_zero(i)) {
+			i++;
+			nval++;
+		}
+		size += 2 * sizeof(uint32_t) + nval * val_size;
+	}
+
+	unsigned char *ptr = (unsigned char *) malloc(size);
+	*buf = ptr;
+	*ptr++ = mode;
+	if (mode == COMP_INT32) {
+		memcpy(ptr, &step, sizeof(double));
+		ptr += sizeof(double);
+	}
+
+	i = 0;
+	while (i < num_int_vars) {
+		uint32_t nzero = 0, nval = 0;
+		while (i < num_int_vars && is_zero(i)) {
+			i++;
+			nzero++;
+		}
+		const int start = i;
+		while (i < num_int_vars && !is_zero(i)) {
+			i++;
+			nval++;
+		}
+		memcpy(ptr, &nzero, sizeof(uint32_t));
+		memcpy(ptr + sizeof(uint32_t), &nval, sizeof(uint32_t));
+		ptr += 2 * sizeof(uint32_t);
+		if (mode == COMP_INT32)
+			memcpy(ptr, &q[start], nval * val_size);
+		else
+			memcpy(ptr, &vars[start], nval * val_size);
+		ptr += nval * val_size;
+	}
+
+	return size;
+}
+
+void micropp_t::decompress_vars(const unsigned char *buf, double *vars)
+{
+	double step = 0.0;
+	const unsigned char mode = *buf++;
+	if (mode == COMP_INT32) {
+		memcpy(&step, buf, sizeof(double));
+		buf += sizeof(double);
+	}
+
+	int i = 0;
+	while (i < num_int_vars) {
+		uint32_t nzero, nval;
+		memcpy(&nzero, buf, sizeof(uint32_t));
+		memcpy(&nval, buf + sizeof(uint32_t), sizeof(uint32_t));
+		buf += 2 * sizeof(uint32_t);
+
+		for (uint32_t j = 0; j < nzero; ++j)
+			vars[i++] = 0.0;
+
+		if (mode == COMP_INT32) {
+			for (uint32_t j = 0; j < nval; ++j) {
+				int32_t val;
+				memcpy(&val, buf, sizeof(int32_t));
+				buf += sizeof(int32_t);
+				vars[i++] = val * step;
+			}
+		} else {
+			memcpy(&vars[i], buf, nval * sizeof(double));
+			buf += nval * sizeof(double);
+			i += nval;
+		}
+	}
+}
+
+void micropp_t::load_int_vars_n(const gp_t &gp, double *vars)
+{
+	if (gp.int_vars_c != NULL)
+		decompress_vars(gp.int_vars_c, vars);
+	else if (gp.int_vars_n != NULL)
+		memcpy(vars, gp.int_vars_n, num_int_vars * sizeof(double));
+	else
+		memset(vars, 0, num_int_vars * sizeof(double));
+}
@@ -0,0 +1,111 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <cassert>
+#include <unordered_set>
+
+#include "micro.hpp"
+
+void micropp_t::set_dedup(const bool on)
+{
+	// Call it between update_vars and the next homogenize
+	if (on && comp_on) {
+		cerr << "micropp : deduplication can not be used with compression" << endl;
+		return;
+	}
+
+	if (on && !dedup_on) {
+		for (auto &gp : gauss_list)
+			if (gp.int_vars_n != NULL) {
+				free_int_vars(gp.int_vars_k);
+				gp.int_vars_n = gp.int_vars_k = dedup_commit(gp.int_vars_n);
+			}
+	} else if (!on && dedup_on) {
+		for (auto &gp : gauss_list)
+			if (gp.int_vars_n != NULL) {
+				double *int_vars_n = alloc_int_vars(false);
+				double *int_vars_k = alloc_int_vars(false);
+				memcpy(int_vars_n, gp.int_vars_n, num_int_vars * sizeof(double));
+				memcpy(int_vars_k, gp.int_vars_k, num_int_vars * sizeof(double));
+				free_int_vars(gp.int_vars_n);
+				free_int_vars(gp.int_vars_k);
+				gp.int_vars_n = int_vars_n;
+				gp.int_vars_k = int_vars_k;
+			}
+	}
+
+	dedup_on = on;
+}
+
+void micropp_t::get_dedup_stats(long *blocks_logical, long *blocks_physical)
+{
+	// int_vars blocks referenced by the points and distinct ones
+	unordered_set<double *> blocks;
+	*blocks_logical = 0;
+	for (auto const &gp : gauss_list)
+		for (double *int_vars : { gp.int_vars_n, gp.int_vars_k })
+			if (int_vars != NULL) {
+				(*blocks_logical)++;
+				blocks.insert(int_vars);
+			}
+	*blocks_physical = blocks.size();
+}
+
+double *micropp_t::dedup_commit(double *int_vars)
+{
+	// Returns the shared block equal to the private int_vars (which is
+	// then released) with two more references, for int_vars_n and k
+	const uint64_t fingerprint = get_fingerprint(int_vars);
+
+	vector<double *> &blocks = dedup_map[fingerprint];
+	for (double *block : blocks)
+		if (memcmp(block, int_vars, num_int_vars * sizeof(double)) == 0) {
+			dedup_ref[block].first += 2;
+			free_int_vars(int_vars);
+			return block;
+		}
+
+	blocks.push_back(int_vars);
+	dedup_ref[int_vars] = make_pair(2, fingerprint);
+	return int_vars;
+}
+
+void micropp_t::unshare_int_vars_k(gp_t &gp)
+{
+	// Copy on write, Newton only writes the rows of the plastic elements
+	if (gp.int_vars_k != NULL && dedup_ref.find(gp.int_vars_k) != dedup_ref.end()) {
+		double *int_vars_k = alloc_int_vars(false);
+		memcpy(int_vars_k, gp.int_vars_k, num_int_vars * sizeof(double));
+		free_int_vars(gp.int_vars_k);
+		gp.int_vars_k = int_vars_k;
+	}
+}
+
+void micropp_t::reshare_int_vars_k(gp_t &gp)
+{
+	// int_vars_k was written equal to int_vars_n, shares it again
+	auto it = dedup_ref.find(gp.int_vars_n);
+	if (gp.int_vars_k != gp.int_vars_n && it != dedup_ref.end()) {
+		free_int_vars(gp.int_vars_k);
+		gp.int_vars_k = gp.int_vars_n;
+		it->second.first++;
+	}
+}
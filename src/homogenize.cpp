@@ -20,6 +20,9 @@
 
 #include <cmath>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 
 #include "micro.hpp"
 
@@ -74,6 +77,18 @@ double micropp_t::get_inv_1(const double *tensor)
 	return NAN;
 }
 
+void micropp_t::get_inv_1(const int n, const double *tensor, double *inv)
+{
+	assert(dim == 2 || dim == 3);
+
+	if (dim == 2)
+		for (int i = 0; i < n; ++i)
+			inv[i] = tensor[i * 3 + 0] + tensor[i * 3 + 1];
+	else if (dim == 3)
+		for (int i = 0; i < n; ++i)
+			inv[i] = tensor[i * 6 + 0] + tensor[i * 6 + 1] + tensor[i * 6 + 2];
+}
+
 double micropp_t::get_inv_2(const double *tensor)
 {
 	if (dim == 3)
@@ -87,73 +102,288 @@ double micropp_t::get_inv_2(const double *tensor)
 	return NAN;
 }
 
-void micropp_t::set_macro_strain(const int gp_id, const double *macro_strain)
+int micropp_t::get_gp_ix(const int gp_id)
+{
+	unordered_map<int, int>::const_iterator it = gauss_map.find(gp_id);
+	return (it == gauss_map.end()) ? -1 : it->second;
+}
+
+void micropp_t::bind_gp_store()
 {
-	list < gp_t >::iterator gp;
-	for (gp = gauss_list.begin(); gp != gauss_list.end(); ++gp) {
-		if (gp->id == gp_id) {
-			for (int i = 0; i < nvoi; ++i)
-				gp->macro_strain[i] = macro_strain[i];
-			break;
+	for (size_t i = 0; i < gauss_list.size(); ++i) {
+		gauss_list[i].macro_strain = &gp_strain[i * nvoi];
+		gauss_list[i].macro_stress = &gp_stress[i * nvoi];
+		gauss_list[i].macro_ctan = &gp_ctan[i * nvoi * nvoi];
+	}
+}
+
+void micropp_t::resize_gp_store(const int capacity)
+{
+	const int ngp = gauss_list.size();
+	assert(capacity >= ngp);
+
+	double *strain = (double *) malloc(capacity * nvoi * sizeof(double));
+	double *stress = (double *) malloc(capacity * nvoi * sizeof(double));
+	double *ctan = (double *) malloc(capacity * nvoi * nvoi * sizeof(double));
+	assert(strain && stress && ctan);
+
+	for (int i = 0; i < ngp; ++i) {
+		const gp_t &gp = gauss_list[i];
+		for (int j = 0; j < nvoi; ++j) {
+			strain[i * nvoi + j] = gp.macro_strain[j];
+			stress[i * nvoi + j] = gp.macro_stress[j];
 		}
+		for (int j = 0; j < nvoi * nvoi; ++j)
+			ctan[i * nvoi * nvoi + j] = gp.macro_ctan[j];
 	}
-	if (gp == gauss_list.end()) {
-		gp_t gp_n;
-		gp_n.id = gp_id;
-		gp_n.int_vars_n = NULL;
-		gp_n.int_vars_k = NULL;
-		for (int i = 0; i < nvoi; i++)
-			gp_n.macro_strain[i] = macro_strain[i];
-		gp_n.inv_max = -1.0e10;
-		gauss_list.push_back(gp_n);
+
+	if (gp_store_owned) {
+		free(gp_strain);
+		free(gp_stress);
+		free(gp_ctan);
 	}
+	gp_strain = strain;
+	gp_stress = stress;
+	gp_ctan = ctan;
+	gp_capacity = capacity;
+	gp_store_owned = true;
+	bind_gp_store();
 }
 
-void micropp_t::get_macro_stress(const int gp_id, double *macro_stress)
+int micropp_t::add_gp(const int gp_id)
+{
+	const int ix = gauss_list.size();
+
+	if (!gp_store_owned) {
+		// Registered buffers can not grow
+		cerr << "micropp : gp_id = " << gp_id
+		     << " is not in the registered buffers, using own storage" << endl;
+		resize_gp_store(2 * ix + 1);
+	} else if (ix == gp_capacity) {
+		resize_gp_store(2 * ix + 1);
+	}
+
+	gp_t gp_n;
+	gp_n.id = gp_id;
+	gp_n.int_vars_n = NULL;
+	gp_n.int_vars_k = NULL;
+	gp_n.int_vars_c = NULL;
+	gp_n.int_vars_c_size = 0;
+	gp_n.rom_vars_n = NULL;
+	gp_n.rom_vars_k = NULL;
+	gp_n.table_eps_n = NULL;
+	gp_n.table_eps_k = NULL;
+	gp_n.inv_max = -1.0e10;
+	gp_n.fingerprint = 0;
+	gp_n.version = -1;
+	for (int i = 0; i < (1 + nvoi); ++i) {
+		gp_n.nr_its[i] = 0;
+		gp_n.nr_err[i] = 0.0;
+	}
+	gp_n.macro_strain = &gp_strain[ix * nvoi];
+	gp_n.macro_stress = &gp_stress[ix * nvoi];
+	gp_n.macro_ctan = &gp_ctan[ix * nvoi * nvoi];
+	for (int i = 0; i < nvoi; ++i) {
+		gp_n.macro_strain[i] = 0.0;
+		gp_n.macro_stress[i] = 0.0;
+	}
+	for (int i = 0; i < nvoi * nvoi; ++i)
+		gp_n.macro_ctan[i] = 0.0;
+
+	gauss_map[gp_id] = ix;
+	gauss_list.push_back(gp_n);
+	return ix;
+}
+
+void micropp_t::set_gp_buffers(const int ngp, const int *gp_id, double *macro_strain,
+                               double *macro_stress, double *macro_ctan)
 {
-	for (auto const &gp:gauss_list)
-		if (gp.id == gp_id) {
-			for (int i = 0; i < nvoi; i++)
-				macro_stress[i] = gp.macro_stress[i];
-			break;
+	vector<gp_t> list_n(ngp);
+	unordered_map<int, int> map_n(ngp);
+
+	for (int i = 0; i < ngp; ++i) {
+		gp_t &gp = list_n[i];
+		int ix = get_gp_ix(gp_id[i]);
+		if (ix >= 0) {
+			gp = gauss_list[ix];
+			for (int j = 0; j < nvoi; ++j)
+				macro_stress[i * nvoi + j] = gp.macro_stress[j];
+			for (int j = 0; j < nvoi * nvoi; ++j)
+				macro_ctan[i * nvoi * nvoi + j] = gp.macro_ctan[j];
+		} else {
+			gp.id = gp_id[i];
+			gp.int_vars_n = NULL;
+			gp.int_vars_k = NULL;
+			gp.int_vars_c = NULL;
+			gp.int_vars_c_size = 0;
+			gp.rom_vars_n = NULL;
+			gp.rom_vars_k = NULL;
+			gp.table_eps_n = NULL;
+			gp.table_eps_k = NULL;
+			gp.inv_max = -1.0e10;
+			gp.fingerprint = 0;
+			gp.version = -1;
+			for (int j = 0; j < (1 + nvoi); ++j) {
+				gp.nr_its[j] = 0;
+				gp.nr_err[j] = 0.0;
+			}
+			for (int j = 0; j < nvoi; ++j)
+				macro_stress[i * nvoi + j] = 0.0;
+			for (int j = 0; j < nvoi * nvoi; ++j)
+				macro_ctan[i * nvoi * nvoi + j] = 0.0;
 		}
+		map_n[gp_id[i]] = i;
+	}
+
+	// Points that are not in the new table are released
+	for (auto const &gp : gauss_list)
+		if (map_n.find(gp.id) == map_n.end()) {
+			free_int_vars(gp.int_vars_n);
+			free_int_vars(gp.int_vars_k);
+			free(gp.int_vars_c);
+			spill_forget(gp.id);
+			free(gp.rom_vars_n);
+			free(gp.rom_vars_k);
+			free(gp.table_eps_n);
+			free(gp.table_eps_k);
+		}
+
+	if (gp_store_owned) {
+		free(gp_strain);
+		free(gp_stress);
+		free(gp_ctan);
+	}
+	gp_strain = macro_strain;
+	gp_stress = macro_stress;
+	gp_ctan = macro_ctan;
+	gp_capacity = ngp;
+	gp_store_owned = false;
+
+	gauss_list.swap(list_n);
+	gauss_map.swap(map_n);
+	bind_gp_store();
+}
+
+void micropp_t::set_macro_strain(const int gp_id, const double *macro_strain)
+{
+	int ix = get_gp_ix(gp_id);
+	if (ix < 0)
+		ix = add_gp(gp_id);
+
+	for (int i = 0; i < nvoi; ++i)
+		gauss_list[ix].macro_strain[i] = macro_strain[i];
+}
+
+void micropp_t::get_macro_stress(const int gp_id, double *macro_stress)
+{
+	int ix = get_gp_ix(gp_id);
+	if (ix >= 0)
+		for (int i = 0; i < nvoi; i++)
+			macro_stress[i] = gauss_list[ix].macro_stress[i];
 }
 
 void micropp_t::get_macro_ctan(const int gp_id, double *macro_ctan)
 {
-	for (auto const &gp:gauss_list)
-		if (gp.id == gp_id) {
-			for (int i = 0; i < (nvoi * nvoi); ++i)
-				macro_ctan[i] = gp.macro_ctan[i];
-			break;
-		}
+	int ix = get_gp_ix(gp_id);
+	if (ix >= 0)
+		for (int i = 0; i < (nvoi * nvoi); ++i)
+			macro_ctan[i] = gauss_list[ix].macro_ctan[i];
 }
 
-void micropp_t::homogenize()
+void micropp_t::set_macro_strains(const int ngp, const int *gp_id, const double *macro_strain)
 {
-	for (auto & gp:gauss_list) {
+	gauss_list.reserve(gauss_list.size() + ngp);
+	gauss_map.reserve(gauss_map.size() + ngp);
+	if (gp_store_owned && gp_capacity < (int) gauss_list.size() + ngp)
+		resize_gp_store(gauss_list.size() + ngp);
 
-		if (!gp.int_vars_n)
-			for (int i = 0; i < num_int_vars; ++i)
-				vars_old[i] = 0.0;
-		else
-			for (int i = 0; i < num_int_vars; ++i)
-				vars_old[i] = gp.int_vars_n[i];
+	for (int i = 0; i < ngp; ++i)
+		set_macro_strain(gp_id[i], &macro_strain[i * nvoi]);
+}
+
+void micropp_t::get_macro_stresses(const int ngp, const int *gp_id, double *macro_stress)
+{
+	for (int i = 0; i < ngp; ++i)
+		get_macro_stress(gp_id[i], &macro_stress[i * nvoi]);
+}
+
+void micropp_t::get_macro_ctans(const int ngp, const int *gp_id, double *macro_ctan)
+{
+	for (int i = 0; i < ngp; ++i)
+		get_macro_ctan(gp_id[i], &macro_ctan[i * nvoi * nvoi]);
+}
 
-		inv_max = -1.0e10;
+template <int N>
+static void lin_stress(const int ngp, const double *ctan, const double *strain, double *stress)
+{
+	// Blocks of 4 points with the sizes known at compile time, the
+	// products are unrolled and vectorized and CL stays in registers
+	double c[N][N];
+	for (int i = 0; i < N; ++i)
+		for (int j = 0; j < N; ++j)
+			c[i][j] = ctan[i * N + j];
+
+	for (int p = 0; p < ngp; p += 4) {
+		const int nb = min(4, ngp - p);
+		const double *eps = &strain[p * N];
+		double sig[4 * N];
+		for (int q = 0; q < nb; ++q)
+			for (int i = 0; i < N; ++i) {
+				double s = 0.0;
+				for (int j = 0; j < N; ++j)
+					s += c[i][j] * eps[q * N + j];
+				sig[q * N + i] = s;
+			}
+		memcpy(&stress[p * N], sig, nb * N * sizeof(double));
+	}
+}
 
-		if ((is_linear(gp.macro_strain) == true) && (gp.int_vars_n == NULL)) {
+void micropp_t::calc_lin_stress(const int ngp, const double *strain, double *stress)
+{
+	// stress (ngp x nvoi) = strain (ngp x nvoi) * CL^T as one small GEMM
+	if (nvoi == 6)
+		lin_stress<6>(ngp, ctan_lin, strain, stress);
+	else
+		lin_stress<3>(ngp, ctan_lin, strain, stress);
+}
 
-			// S = CL : E
-			for (int i = 0; i < nvoi; ++i) {
-				gp.macro_stress[i] = 0.0;
-				for (int j = 0; j < nvoi; ++j)
-					gp.macro_stress[i] += ctan_lin[i * nvoi + j] * gp.macro_strain[j];
+void micropp_t::homogenize()
+{
+	const int ngp = gauss_list.size();
+
+	// Linear predictor and I1 screening for all the points at once
+	vector<double> inv(ngp);
+	calc_lin_stress(ngp, gp_strain, gp_stress);
+	get_inv_1(ngp, gp_stress, inv.data());
+	sur_served = sur_solved = 0;
+	stats_id.clear();
+	stats_rec.clear();
+
+	for (int p = 0; p < ngp; ++p) {
+
+		gp_t &gp = gauss_list[p];
+		gp.inv_max = fabs(inv[p]);
+		gp.macro_ctan = &gp_ctan[p * nvoi * nvoi];
+
+		if (spill_on) {
+			spill_touch(gp);
+			if (p + 1 < ngp && spill_map.find(gauss_list[p + 1].id) == spill_map.end()) {
+				const gp_t &gp_next = gauss_list[p + 1];
+				arena_prefetch(&vars_arena, gp_next.int_vars_n);
+				if (gp_next.int_vars_k != gp_next.int_vars_n)
+					arena_prefetch(&vars_arena, gp_next.int_vars_k);
 			}
-			// C = CL
-			for (int i = 0; i < nvoi; ++i)
-				for (int j = 0; j < nvoi; ++j)
-					gp.macro_ctan[i * nvoi + j] = ctan_lin[i * nvoi + j];
+		}
+
+		if ((gp.inv_max < inv_tol) && (gp.int_vars_n == NULL) && (gp.int_vars_c == NULL) &&
+		    (gp.rom_vars_n == NULL) && (gp.table_eps_n == NULL)) {
+
+			// S = CL : E is already in the store, C = CL is shared with
+			// the owned store and copied into the caller buffers
+			if (gp_store_owned)
+				gp.macro_ctan = ctan_lin;
+			else
+				memcpy(gp.macro_ctan, ctan_lin, nvoi * nvoi * sizeof(double));
 
 			for (int i = 0; i < (1 + nvoi); ++i) {
 				gp.nr_its[i] = 0;
@@ -162,56 +392,205 @@ void micropp_t::homogenize()
 
 		} else {
 
-			// SIGMA
-			int nr_its;
-			bool nl_flag;
-			double nr_err;
-			set_displ(gp.macro_strain);
-			newton_raphson(&nl_flag, &nr_its, &nr_err);
-			calc_ave_stress(gp.macro_stress);
-
-			if (nl_flag == true) {
-				if (gp.int_vars_n == NULL) {
-					gp.int_vars_k = (double *) malloc(num_int_vars * sizeof(double));
-					gp.int_vars_n = (double *) malloc(num_int_vars * sizeof(double));
-					for (int i = 0; i < num_int_vars; ++i)
-						gp.int_vars_n[i] = 0.0;
+			// Recorded once per step, the version of a point without state
+			// only marks that it is already in vars_first
+			if (gp.int_vars_n == NULL && gp.int_vars_c == NULL && gp.rom_vars_n == NULL &&
+			    gp.table_eps_n == NULL && gp.version != vars_version) {
+				vars_first.push_back(gp.id);
+				gp.version = vars_version;
+			}
+
+			if (table_on && table_lookup(gp))
+				continue;
+			if (gp.table_eps_n != NULL)
+				table_restore(gp);
+
+			if (rom_on || pod_on) {
+				rom_solve_gp(gp);
+				continue;
+			}
+
+			if (cache_on && cache_lookup(gp))
+				continue;
+
+			if (sur_on) {
+				if (surrogate_lookup(gp)) {
+					sur_served++;
+					continue;
 				}
-				for (int i = 0; i < num_int_vars; ++i)
-					gp.int_vars_k[i] = vars_new[i];
+				solve_gp(gp);
+				surrogate_insert(gp);
+				sur_solved++;
+				continue;
 			}
 
-			gp.nr_its[0] = nr_its;
-			gp.nr_err[0] = nr_err;
+			solve_gp(gp);
+		}
+	}
+}
 
-			// CTAN
-			double eps_1[6], sig_0[6], sig_1[6], dEps = 1.0e-8;
-			for (int v = 0; v < nvoi; ++v)
-				sig_0[v] = gp.macro_stress[v];
+void micropp_t::solve_gp(gp_t &gp)
+{
+	// Newton reads the committed state in place and, if the point has
+	// history, writes the trial one straight into int_vars_k
+	const bool history = (gp.int_vars_n != NULL || gp.int_vars_c != NULL);
+	if (gp.int_vars_n != NULL) {
+		vars_old = gp.int_vars_n;
+	} else {
+		load_int_vars_n(gp, vars_old_buf);
+		vars_old = vars_old_buf;
+	}
+	if (history) {
+		if (gp.int_vars_k == NULL) {
+			// First trial after a restore or with compression
+			gp.int_vars_k = alloc_int_vars(false);
+			memcpy(gp.int_vars_k, vars_old, num_int_vars * sizeof(double));
+		} else {
+			unshare_int_vars_k(gp);
+		}
+		vars_new = gp.int_vars_k;
+	}
 
-			for (int i = 0; i < nvoi; ++i) {
-				for (int v = 0; v < nvoi; ++v)
-					eps_1[v] = gp.macro_strain[v];
-				eps_1[i] += dEps;
+	// SIGMA
+	int nr_its;
+	bool nl_flag;
+	double nr_err;
+	set_displ(gp.macro_strain);
+	newton_raphson(&nl_flag, &nr_its, &nr_err);
+	calc_ave_stress(gp.macro_stress, stats_on ? stats_ip.data() : NULL);
+	vars_new = vars_new_buf;
+	if (stats_on && gp.id >= 0)
+		calc_stats(gp);
+	if (!watch_u.empty())
+		watch_store(gp);
+
+	if (nl_flag == true) {
+		if (!history) {
+			if (gp.int_vars_k == NULL)
+				gp.int_vars_k = alloc_int_vars(false);
+			if (!comp_on)
+				gp.int_vars_n = alloc_int_vars(true);
+			memcpy(gp.int_vars_k, vars_new_buf, num_int_vars * sizeof(double));
+		}
+		gp.version = vars_version;
+		if (spill_on)
+			spill_touch(gp);
+	} else if (history && dedup_on) {
+		reshare_int_vars_k(gp);
+	}
 
-				set_displ(eps_1);
-				newton_raphson(&nl_flag, &nr_its, &nr_err);
-				calc_ave_stress(sig_1);
-				for (int v = 0; v < nvoi; ++v)
-					gp.macro_ctan[v * nvoi + i] = (sig_1[v] - sig_0[v]) / dEps;
+	if (pod_snap_on)
+		pod_add_snapshot(gp.macro_strain);
 
-				gp.nr_its[1 + i] = nr_its;
-				gp.nr_err[1 + i] = nr_err;
+	bool gp_nl_flag = nl_flag;
+	gp.nr_its[0] = nr_its;
+	gp.nr_err[0] = nr_err;
+
+	// CTAN
+	double eps_1[6], sig_0[6], sig_1[6], dEps = 1.0e-8;
+	for (int v = 0; v < nvoi; ++v)
+		sig_0[v] = gp.macro_stress[v];
+
+	for (int i = 0; i < nvoi; ++i) {
+		for (int v = 0; v < nvoi; ++v)
+			eps_1[v] = gp.macro_strain[v];
+		eps_1[i] += dEps;
+
+		set_displ(eps_1);
+		newton_raphson(&nl_flag, &nr_its, &nr_err);
+		calc_ave_stress(sig_1);
+		for (int v = 0; v < nvoi; ++v)
+			gp.macro_ctan[v * nvoi + i] = (sig_1[v] - sig_0[v]) / dEps;
+
+		gp.nr_its[1 + i] = nr_its;
+		gp.nr_err[1 + i] = nr_err;
+	}
+
+	vars_old = vars_old_buf;
+
+	if (cache_on)
+		cache_insert(gp, gp_nl_flag);
+}
+
+void micropp_t::reset_int_vars_k(gp_t &gp)
+{
+	// A response without state leaves the committed one, the trial of an
+	// earlier homogenize of this step is replaced by it
+	if (gp.version != vars_version || gp.int_vars_k == NULL)
+		return;
+	if (dedup_on)
+		reshare_int_vars_k(gp);
+	if (gp.int_vars_k != gp.int_vars_n)
+		load_int_vars_n(gp, gp.int_vars_k);
+}
+
+void micropp_t::update_vars()
+{
+	// Commits the trials of this step by swapping the buffers
+	for (auto &gp:gauss_list) {
+		const bool trial = (gp.version == vars_version);
+
+		if (comp_on) {
+			if (gp.int_vars_k != NULL) {
+				if (trial) {
+					free(gp.int_vars_c);
+					gp.int_vars_c_size = compress_vars(gp.int_vars_k,
+					                                   &gp.int_vars_c);
+				}
+				free_int_vars(gp.int_vars_k);
+				gp.int_vars_k = NULL;
+			}
+		} else if (trial && gp.int_vars_n != NULL) {
+			if (spill_on)
+				spill_touch(gp);
+			if (dedup_on) {
+				free_int_vars(gp.int_vars_n);
+				gp.int_vars_n = gp.int_vars_k = dedup_commit(gp.int_vars_k);
+			} else {
+				swap(gp.int_vars_n, gp.int_vars_k);
 			}
+			if (cache_on)
+				gp.fingerprint = get_fingerprint(gp.int_vars_n);
 		}
-		gp.inv_max = inv_max;
+
+		if (trial && gp.rom_vars_n != NULL)
+			swap(gp.rom_vars_n, gp.rom_vars_k);
+		if (trial && gp.table_eps_n != NULL)
+			swap(gp.table_eps_n, gp.table_eps_k);
 	}
+
+	vars_first.clear();
+	vars_version++;
 }
 
-void micropp_t::update_vars()
+void micropp_t::rollback_vars()
 {
-	for (auto const &gp:gauss_list)
-		if (gp.int_vars_n != NULL)
-			for (int i = 0; i < num_int_vars; ++i)
-				gp.int_vars_n[i] = gp.int_vars_k[i];
+	// The trials of this step are left behind and overwritten by the
+	// next ones. macro_stress and macro_ctan are recomputed by homogenize.
+	// The points that had no history before the step have nothing to go
+	// back to, so their state is released and they are elastic again.
+	for (int id : vars_first) {
+		const int ix = get_gp_ix(id);
+		if (ix < 0)
+			continue;
+		gp_t &gp = gauss_list[ix];
+		free_int_vars(gp.int_vars_n);
+		free_int_vars(gp.int_vars_k);
+		free(gp.int_vars_c);
+		free(gp.rom_vars_n);
+		free(gp.rom_vars_k);
+		free(gp.table_eps_n);
+		free(gp.table_eps_k);
+		gp.int_vars_n = gp.int_vars_k = NULL;
+		gp.int_vars_c = NULL;
+		gp.int_vars_c_size = 0;
+		gp.rom_vars_n = gp.rom_vars_k = NULL;
+		gp.table_eps_n = gp.table_eps_k = NULL;
+		gp.fingerprint = 0;
+		if (spill_on)
+			spill_forget(gp.id);
+	}
+	vars_first.clear();
+	sur_served = sur_solved = 0;
+	vars_version++;
 }
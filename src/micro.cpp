@@ -21,62 +21,140 @@
 #include <vector>
 #include <iostream>
 
+#include <cstring>
 #include <cassert>
+#include <algorithm>
 
 #include "micro.hpp"
 
 micropp_t::micropp_t(const int _dim, const int size[3], const int _micro_type,
-                     const double *_micro_params, const int *mat_types, const double *params):
+                     const double *_micro_params, const int *mat_types, const double *params,
+                     const int num_mats):
 	dim(_dim),
 
-	lx(_micro_params[0]),
-	ly(_micro_params[1]),
-	lz(dim == 2 ? 0.0 : _micro_params[2]),
-	width(_micro_params[3]),
-
-	inv_tol(micro_params[4]),
 	nx(size[0]),
 	ny(size[1]),
 	nz(_dim == 2 ? 1 : size[2]),
 	nn(nx * ny * nz),
 
+	lx(_micro_params[0]),
+	ly(_micro_params[1]),
+	lz(dim == 2 ? 0.0 : _micro_params[2]),
+
 	dx(lx / (nx - 1)),
 	dy(ly / (ny - 1)),
 	dz(lz / (nz - 1)),
 
+	width(_micro_params[3]),
+	inv_tol(_micro_params[4]),
+
 	npe(dim == 2 ? 4 : 8),
 	nvoi(dim == 2 ? 3 : 6),
 	nelem(dim == 2 ? (nx - 1) * (ny - 1) : (nx - 1) * (ny - 1) * (nz - 1)),
 
 	micro_type(_micro_type),
 	num_int_vars(nelem * 8 * NUM_VAR_GP),
-	output_files_header(false)
+	output_files_header(false),
+	vtu_format(VTU_ASCII),
+
+	gp_strain(NULL),
+	gp_stress(NULL),
+	gp_ctan(NULL),
+	gp_capacity(0),
+	gp_store_owned(true),
+
+	vars_version(0),
+
+	dedup_on(false),
+
+	comp_on(false),
+	comp_tol(0.0),
+
+	spill_on(false),
+	spill_max(0),
+	spill_evictions(0),
+
+	cache_on(false),
+	cache_tol(0.0),
+	cache_max(0),
+	cache_next(0),
+	cache_hits(0),
+	cache_near_hits(0),
+	cache_misses(0),
+
+	table_on(false),
+	table_bytes(0),
+	table_header(NULL),
+	table_data(NULL),
+	table_hits(0),
+
+	rom_on(false),
+	rom_nclus(0),
+
+	pod_on(false),
+	pod_snap_on(false),
+	pod_nsnap(0),
+	pod_nmodes(0),
+	pod_npts(0),
+	pod_vol(0.0),
+
+	sur_on(false),
+	sur_tol(0.0),
+	sur_len(1.0),
+	sur_max(0),
+	sur_n(0),
+	sur_served(0),
+	sur_solved(0),
+
+	writer(NULL),
+	pvd_series({ 0, -1, 0 }),
+	xmf_series({ 0, -1, 0 }),
+
+	watch_hits(0),
+	watch_solves(0),
+
+	stats_on(false),
+	stats_stride(0),
+	stats_file(NULL),
+
+	log_on(false),
+	log_vars_every(0),
+	log_step(0),
+	log_ngp(0)
 {
 	assert(dim == 2 || dim == 3);
 
+	for (int d = 0; d < 3; ++d)
+		stats_ncoarse[d] = 0;
 
 	b = (double *) malloc(nn * dim * sizeof(double));
 	du = (double *) malloc(nn * dim * sizeof(double));
-	u = (double *) malloc(nn * dim * sizeof(double));
+	u = (double *) calloc(nn * dim, sizeof(double));
 	elem_stress = (double *) malloc(nelem * nvoi * sizeof(double));
 	elem_strain = (double *) malloc(nelem * nvoi * sizeof(double));
 	elem_type = (int *) malloc(nelem * sizeof(int));
-	vars_old = (double *) malloc(num_int_vars * sizeof(double));
-	vars_new = (double *) malloc(num_int_vars * sizeof(double));
+	elem_mat = (uint8_t *) malloc(nelem * sizeof(uint8_t));
+	vars_old_buf = (double *) calloc(num_int_vars, sizeof(double));
+	vars_new_buf = (double *) calloc(num_int_vars, sizeof(double));
+	vars_old = vars_old_buf;
+	vars_new = vars_new_buf;
 
 	assert( b && du && u && elem_stress && elem_strain &&
-	        elem_type && vars_old && vars_new );
+	        elem_type && elem_mat && vars_old_buf && vars_new_buf );
 
+	arena_init(&vars_arena, num_int_vars * sizeof(double));
+
+	assert(num_mats >= 2 && num_mats <= MAX_MATS);
 	int nParams;
 	if (micro_type == 0) {
 		// mat 1 = matrix
 		// mat 2 = sphere
-		numMaterials = 2;
+		numMaterials = num_mats;
 		nParams = 5;
 	} else if (micro_type == 1) {
 		// mat 1 = layer 1
 		// mat 2 = layer 2
-		numMaterials = 2;
+		numMaterials = num_mats;
 		nParams = 5;
 	}
 
@@ -87,52 +165,40 @@ micropp_t::micropp_t(const int _dim, const int size[3], const int _micro_type,
 	file.open("micropp_materials.dat");
 	file << scientific;
 	for (int i = 0; i < numMaterials; i++) {
-		material_list[i].E  = params[i * MAX_MAT_PARAM + 0];
-		material_list[i].nu = params[i * MAX_MAT_PARAM + 1];
-		material_list[i].Sy = params[i * MAX_MAT_PARAM + 2];
-		material_list[i].Ka = params[i * MAX_MAT_PARAM + 3];
+		mats.E[i]  = params[i * MAX_MAT_PARAM + 0];
+		mats.nu[i] = params[i * MAX_MAT_PARAM + 1];
+		mats.Sy[i] = params[i * MAX_MAT_PARAM + 2];
+		mats.Ka[i] = params[i * MAX_MAT_PARAM + 3];
 
-		material_list[i].k = material_list[i].E / (3 * (1 - 2 * material_list[i].nu));
-		material_list[i].mu = material_list[i].E / (2 * (1 + material_list[i].nu));
-		material_list[i].lambda = (material_list[i].nu * material_list[i].E) /
-			((1 + material_list[i].nu) * (1 - 2 * material_list[i].nu));	// lambda
+		mats.k[i] = mats.E[i] / (3 * (1 - 2 * mats.nu[i]));
+		mats.mu[i] = mats.E[i] / (2 * (1 + mats.nu[i]));
+		mats.lambda[i] = (mats.nu[i] * mats.E[i]) /
+			((1 + mats.nu[i]) * (1 - 2 * mats.nu[i]));	// lambda
 
 		if (mat_types[i] == 0) {
 			// lineal
-			material_list[i].plasticity = false;
-			material_list[i].damage = false;
+			mats.plasticity[i] = false;
+			mats.damage[i] = false;
 		} else if (mat_types[i] == 1) {
 			// con plasticidad
-			material_list[i].plasticity = true;
-			material_list[i].damage = false;
+			mats.plasticity[i] = true;
+			mats.damage[i] = false;
 		} else if (mat_types[i] == 2) {
 			// con daño
-			material_list[i].plasticity = false;
-			material_list[i].damage = true;
+			mats.plasticity[i] = false;
+			mats.damage[i] = true;
 		}
-		file << setw(14) << material_list[i].E << " " << material_list[i].nu
-		     << " " << material_list[i].Sy << " " << material_list[i].Ka << endl;
+		file << setw(14) << mats.E[i] << " " << mats.nu[i]
+		     << " " << mats.Sy[i] << " " << mats.Ka[i] << endl;
 	}
 	file.close();
 
+	calc_elem_types();
 	if (dim == 2) {
-		for (int ex = 0; ex < nx - 1; ex++) {
-			for (int ey = 0; ey < ny - 1; ey++) {
-				int e = glo_elem3D(ex, ey, 0);
-				elem_type[e] = get_elem_type2D(ex, ey);
-			}
-		}
 		ell_init_2D(&A, dim, nx, ny);
 	} else if (dim == 3) {
-		for (int ex = 0; ex < nx - 1; ex++) {
-			for (int ey = 0; ey < ny - 1; ey++) {
-				for (int ez = 0; ez < nz - 1; ez++) {
-					int e = glo_elem3D(ex, ey, ez);
-					elem_type[e] = get_elem_type3D(ex, ey, ez);
-				}
-			}
-		}
 		ell_init_3D(&A, dim, nx, ny, nz);
+		calc_dsh_gp();
 	}
 
 	calc_ctan_lin();
@@ -145,8 +211,114 @@ micropp_t::micropp_t(const int _dim, const int size[3], const int _micro_type,
 	file.close();
 }
 
+double *micropp_t::alloc_int_vars(const bool zero)
+{
+	double *int_vars = (double *) arena_alloc(&vars_arena);
+	assert(int_vars != NULL);
+	if (zero)
+		memset(int_vars, 0, num_int_vars * sizeof(double));
+	return int_vars;
+}
+
+void micropp_t::free_int_vars(double *int_vars)
+{
+	if (int_vars == NULL)
+		return;
+
+	// Shared blocks go back to the arena with their last reference
+	auto it = dedup_ref.find(int_vars);
+	if (it != dedup_ref.end()) {
+		if (--it->second.first > 0)
+			return;
+		vector<double *> &blocks = dedup_map[it->second.second];
+		blocks.erase(find(blocks.begin(), blocks.end(), int_vars));
+		if (blocks.empty())
+			dedup_map.erase(it->second.second);
+		dedup_ref.erase(it);
+	}
+	arena_free(&vars_arena, int_vars);
+}
+
+void micropp_t::get_arena_stats(size_t *reserved, size_t *in_use)
+{
+	*reserved = arena_reserved(&vars_arena);
+	*in_use = arena_in_use(&vars_arena);
+}
+
+bool micropp_t::set_spill(const char *dir, const size_t ram_budget)
+{
+	if (comp_on) {
+		cerr << "micropp : the spill can not be used with compression" << endl;
+		return false;
+	}
+	if (arena_in_use(&vars_arena) > 0) {
+		cerr << "micropp : set_spill has to be called before allocating int_vars" << endl;
+		return false;
+	}
+
+	arena_destroy(&vars_arena);
+	if (!arena_init_file(&vars_arena, num_int_vars * sizeof(double), dir)) {
+		arena_init(&vars_arena, num_int_vars * sizeof(double));
+		return false;
+	}
+
+	spill_on = true;
+	spill_max = max((size_t) 1, ram_budget / (2 * vars_arena.block_size));
+	spill_evictions = 0;
+	spill_lru.clear();
+	spill_map.clear();
+	return true;
+}
+
+void micropp_t::get_spill_stats(long *evictions, int *resident)
+{
+	*evictions = spill_evictions;
+	*resident = spill_lru.size();
+}
+
+void micropp_t::spill_touch(const gp_t &gp)
+{
+	// Only the points of the table are accounted
+	if (gp.int_vars_n == NULL || get_gp_ix(gp.id) < 0)
+		return;
+
+	auto it = spill_map.find(gp.id);
+	if (it != spill_map.end()) {
+		spill_lru.splice(spill_lru.begin(), spill_lru, it->second);
+		return;
+	}
+
+	spill_lru.push_front(gp.id);
+	spill_map[gp.id] = spill_lru.begin();
+
+	while ((int) spill_lru.size() > spill_max) {
+		const int id = spill_lru.back();
+		spill_lru.pop_back();
+		spill_map.erase(id);
+
+		const gp_t &gp_old = gauss_list[get_gp_ix(id)];
+		arena_evict(&vars_arena, gp_old.int_vars_n);
+		arena_evict(&vars_arena, gp_old.int_vars_k);
+		spill_evictions++;
+	}
+}
+
+void micropp_t::spill_forget(const int gp_id)
+{
+	auto it = spill_map.find(gp_id);
+	if (it != spill_map.end()) {
+		spill_lru.erase(it->second);
+		spill_map.erase(it);
+	}
+}
+
 micropp_t::~micropp_t()
 {
+	// The queued output is written before anything is released
+	set_async_output(false, 1);
+	close_log();
+	close_stats();
+
 	ell_free(&A);
 
 	free(b);
@@ -155,23 +327,68 @@ micropp_t::~micropp_t()
 	free(elem_stress);
 	free(elem_strain);
 	free(elem_type);
-	free(vars_old);
-	free(vars_new);
+	free(elem_mat);
+	free(vars_old_buf);
+	free(vars_new_buf);
 
 	for (auto const &gp:gauss_list) {
-		free(gp.int_vars_n);
-		free(gp.int_vars_k);
+		free_int_vars(gp.int_vars_n);
+		free_int_vars(gp.int_vars_k);
+		free(gp.int_vars_c);
+		free(gp.rom_vars_n);
+		free(gp.rom_vars_k);
+		free(gp.table_eps_n);
+		free(gp.table_eps_k);
+	}
+
+	cache_clear();
+	surrogate_clear();
+	unload_table();
+	arena_destroy(&vars_arena);
+
+	if (gp_store_owned) {
+		free(gp_strain);
+		free(gp_stress);
+		free(gp_ctan);
 	}
 }
 
 void micropp_t::get_nl_flag(int gp_id, int *non_linear)
 {
-	*non_linear = 0;
-	for (auto const &gp : gauss_list)
-		if (gp.id == gp_id) {
-			*non_linear = (gp.int_vars_n != NULL);
-			break;
+	int ix = get_gp_ix(gp_id);
+	*non_linear = (ix >= 0) ?
+		(gauss_list[ix].int_vars_n != NULL || gauss_list[ix].int_vars_c != NULL ||
+		 gauss_list[ix].rom_vars_n != NULL || gauss_list[ix].table_eps_n != NULL) : 0;
+}
+
+void micropp_t::calc_elem_types()
+{
+	if (dim == 2) {
+		for (int ex = 0; ex < nx - 1; ex++) {
+			for (int ey = 0; ey < ny - 1; ey++) {
+				int e = glo_elem3D(ex, ey, 0);
+				elem_type[e] = get_elem_type2D(ex, ey);
+			}
 		}
+	} else if (dim == 3) {
+		for (int ex = 0; ex < nx - 1; ex++) {
+			for (int ey = 0; ey < ny - 1; ey++) {
+				for (int ez = 0; ez < nz - 1; ez++) {
+					int e = glo_elem3D(ex, ey, ez);
+					elem_type[e] = get_elem_type3D(ex, ey, ez);
+				}
+			}
+		}
+	}
+	calc_elem_mats();
+}
+
+void micropp_t::calc_elem_mats()
+{
+	// The analytic geometries have the matrix (0) and the inclusion (1),
+	// the images give the material directly
+	for (int e = 0; e < nelem; ++e)
+		elem_mat[e] = (uint8_t) elem_type[e];
 }
 
 int micropp_t::get_elem_type2D(int ex, int ey)
@@ -0,0 +1,125 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Collective output of a set of points. Their fields are computed one
+ * after the other (the solver state is shared) and the VTU pieces are
+ * formatted, compressed and written by nthreads threads. The snapshots go
+ * to the writer in batches, so at most one batch per queued job is kept.
+ * The step is indexed by micropp_<time_step>.vtm and micropp.pvd collects
+ * the steps. With VTU_XDMF micropp.xmf collects them instead, every step
+ * is a spatial collection of the grids of the points.
+ */
+
+#include <cassert>
+#include <thread>
+#include <sstream>
+#include <string>
+
+#include "micro.hpp"
+
+void micropp_t::output_collective(const int time_step, const int ngp, const int *gp_id,
+                                  const int nthreads)
+{
+	assert(nthreads > 0);
+
+	const int batch = 2 * nthreads;
+	const int format = vtu_format;
+	shared_ptr<vector<int>> ids = make_shared<vector<int>>();
+
+	for (int i0 = 0; i0 < ngp; i0 += batch) {
+		shared_ptr<vector<vtu_snapshot_t>> snaps = make_shared<vector<vtu_snapshot_t>>();
+		snaps->reserve(batch);
+		for (int i = i0; i < min(ngp, i0 + batch); ++i) {
+			if (!output_fields(gp_id[i]))
+				continue;
+			snaps->push_back(vtu_snapshot_t());
+			take_vtu_snapshot(snaps->back(), time_step, gp_id[i]);
+			ids->push_back(gp_id[i]);
+		}
+		if (snaps->empty())
+			continue;
+
+		io_submit([this, snaps, format, nthreads] {
+			const int n = snaps->size();
+
+			// The XDMF series of the points share their step lists
+			if (format == VTU_XDMF) {
+				for (auto const &snap : *snaps)
+					write_vtu_snapshot(snap);
+				return;
+			}
+
+			vector<std::thread> threads;
+			for (int t = 0; t < min(nthreads, n); ++t)
+				threads.push_back(std::thread([this, snaps, n, t, nthreads] {
+					for (int i = t; i < n; i += nthreads)
+						write_vtu_snapshot((*snaps)[i]);
+				}));
+			for (auto &thr : threads)
+				thr.join();
+		});
+	}
+
+	io_submit([this, ids, format, time_step] { write_vtm(*ids, format, time_step); });
+}
+
+void micropp_t::write_vtm(const vector<int> &gp_id, const int format, const int time_step)
+{
+	if (format == VTU_XDMF) {
+		// The step was the last one written to the series of the points
+		std::stringstream x;
+		x << "<Grid Name=\"step_" << time_step
+		  << "\" GridType=\"Collection\" CollectionType=\"Spatial\">\n"
+		  << "<Time Value=\"" << time_step << "\"/>\n";
+		for (auto id : gp_id)
+			x << get_xdmf_grid("gp_" + to_string(id), id, time_step,
+			                   xdmf_series[id].nsteps - 1);
+		x << "</Grid>\n";
+
+		append_series("micropp.xmf", xmf_series, time_step,
+		              "<?xml version=\"1.0\" ?>\n<Xdmf Version=\"3.0\">\n<Domain>\n"
+		              "<Grid Name=\"micropp\" GridType=\"Collection\" "
+		              "CollectionType=\"Temporal\">\n",
+		              x.str(), "</Grid>\n</Domain>\n</Xdmf>\n");
+		return;
+	}
+
+	std::stringstream fname;
+	fname << "micropp_" << time_step << ".vtm";
+
+	ofstream vtm(fname.str());
+	vtm << "<?xml version=\"1.0\"?>\n"
+	    << "<VTKFile type=\"vtkMultiBlockDataSet\" version=\"1.0\">\n"
+	    << "<vtkMultiBlockDataSet>\n";
+	for (size_t i = 0; i < gp_id.size(); ++i)
+		vtm << "<DataSet index=\"" << i << "\" name=\"gp_" << gp_id[i]
+		    << "\" file=\"micropp_" << gp_id[i] << "_" << time_step << ".vtu\"/>\n";
+	vtm << "</vtkMultiBlockDataSet>\n</VTKFile>\n";
+	vtm.close();
+
+	// A step written again replaces its entry
+	append_series("micropp.pvd", pvd_series, time_step,
+	              "<?xml version=\"1.0\"?>\n<VTKFile type=\"Collection\" version=\"0.1\">\n"
+	              "<Collection>\n",
+	              "<DataSet timestep=\"" + to_string(time_step) + "\" file=\"micropp_" +
+	              to_string(time_step) + ".vtm\"/>\n",
+	              "</Collection>\n</VTKFile>\n");
+}
@@ -26,42 +26,144 @@
 
 using namespace std;
 
+void micropp_t::set_watch(const int ngp, const int *gp_id)
+{
+	watch_u.clear();
+	for (int i = 0; i < ngp; ++i)
+		watch_u[gp_id[i]] = vector<double>();
+}
+
+void micropp_t::get_watch_stats(long *hits, long *solves)
+{
+	*hits = watch_hits;
+	*solves = watch_solves;
+}
+
+void micropp_t::watch_store(const gp_t &gp)
+{
+	// Keeps the strain and the converged u of a watched point
+	auto it = watch_u.find(gp.id);
+	if (it == watch_u.end())
+		return;
+
+	vector<double> &w = it->second;
+	w.resize(nvoi + nn * dim);
+	for (int i = 0; i < nvoi; ++i)
+		w[i] = gp.macro_strain[i];
+	for (int i = 0; i < nn * dim; ++i)
+		w[nvoi + i] = u[i];
+}
+
+bool micropp_t::watch_load(const gp_t &gp)
+{
+	auto it = watch_u.find(gp.id);
+	if (it == watch_u.end() || it->second.empty())
+		return false;
+
+	const vector<double> &w = it->second;
+	for (int i = 0; i < nvoi; ++i)
+		if (w[i] != gp.macro_strain[i])
+			return false;
+	for (int i = 0; i < nn * dim; ++i)
+		u[i] = w[nvoi + i];
+	return true;
+}
+
+bool micropp_t::output_fields(const int gp_id)
+{
+	int ix = get_gp_ix(gp_id);
+	if (ix < 0)
+		return false;
+
+	const gp_t &gp = gauss_list[ix];
+	load_int_vars_n(gp, vars_old);
+
+	// Watched points solved by the last homogenize are only post-processed
+	if (watch_load(gp)) {
+		watch_hits++;
+	} else {
+		int nr_its;
+		bool nl_flag;
+		double nr_err;
+		set_displ((double *)gp.macro_strain);
+		newton_raphson(&nl_flag, &nr_its, &nr_err);
+		watch_solves++;
+	}
+
+	calc_fields();
+	return true;
+}
+
 void micropp_t::output(int time_step, int gp_id)
 {
-	for (auto const &gp:gauss_list)
-		if (gp.id == gp_id) {
-			if (gp.int_vars_n != NULL)
-				for (int i = 0; i < num_int_vars; ++i)
-					vars_old[i] = gp.int_vars_n[i];
-			else
-				for (int i = 0; i < num_int_vars; ++i)
-					vars_old[i] = 0.0;
-
-			int nr_its;
-			bool nl_flag;
-			double nr_err;
-			set_displ((double *)gp.macro_strain);
-			newton_raphson(&nl_flag, &nr_its, &nr_err);
-
-			calc_fields();
-			write_vtu(time_step, gp_id);
-			break;
-		}
+	if (output_fields(gp_id))
+		write_vtu(time_step, gp_id);
 }
 
 void micropp_t::write_vtu(int time_step, int gp_id)
 {
+	shared_ptr<vtu_snapshot_t> snap = make_shared<vtu_snapshot_t>();
+	take_vtu_snapshot(*snap, time_step, gp_id);
+	io_submit([this, snap] { write_vtu_snapshot(*snap); });
+}
+
+void micropp_t::take_vtu_snapshot(vtu_snapshot_t &snap, const int time_step, const int gp_id)
+{
+	snap.time_step = time_step;
+	snap.gp_id = gp_id;
+	snap.format = vtu_format;
+	snap.u.assign(u, u + nn * dim);
+	if (vtu_format != VTU_XDMF)
+		snap.b.assign(b, b + nn * dim);
+	snap.elem_strain.assign(elem_strain, elem_strain + nelem * nvoi);
+	snap.elem_stress.assign(elem_stress, elem_stress + nelem * nvoi);
+	snap.plasticity.assign(nelem, 0.0);
+	snap.hardening.assign(nelem, 0.0);
+	snap.elem_type.assign(elem_type, elem_type + nelem);
+	if (dim == 3)
+		for (int e = 0; e < nelem; ++e) {
+			for (int gp = 0; gp < 8; ++gp) {
+				double eps_p[7];
+				for (int v = 0; v < 7; ++v)
+					eps_p[v] = vars_old[intvar_ix(e, gp, v)];
+				snap.plasticity[e] += sqrt(eps_p[0] * eps_p[0] + eps_p[1] * eps_p[1] +
+				                           eps_p[2] * eps_p[2] + 2 * eps_p[3] * eps_p[3] +
+				                           2 * eps_p[4] * eps_p[4] + 2 * eps_p[5] * eps_p[5]);
+				snap.hardening[e] += eps_p[6];
+			}
+			snap.plasticity[e] /= 8;
+			snap.hardening[e] /= 8;
+		}
+}
+
+void micropp_t::write_vtu_snapshot(const vtu_snapshot_t &snap)
+{
+	if (snap.format == VTU_ASCII)
+		write_vtu_ascii(snap);
+	else if (snap.format == VTU_XDMF)
+		write_xdmf(snap);
+	else
+		write_vtu_appended(snap);
+}
+
+void micropp_t::write_vtu_ascii(const vtu_snapshot_t &snap)
+{
+	const int time_step = snap.time_step, gp_id = snap.gp_id;
+	const double *u = snap.u.data(), *b = snap.b.data();
+	const double *elem_strain = snap.elem_strain.data();
+	const double *elem_stress = snap.elem_stress.data();
+	const int *elem_type = snap.elem_type.data();
+
 	std::stringstream fname_vtu_s;
 	fname_vtu_s << "micropp_" << gp_id << "_" << time_step << ".vtu";
 	std::string fname_vtu = fname_vtu_s.str();
 
 	ofstream file;
 	file.open(fname_vtu);
-	file << "<?xml version=\"1.0\"?>" << endl
+	file << "<?xml version=\"1.0\"?>\n"
 	     <<
-		"<VTKFile type=\"UnstructuredGrid\" version=\"0.1\" byte_order=\"LittleEndian\">"
-	     << endl << "<UnstructuredGrid>" << endl << "<Piece NumberOfPoints=\"" << nn
-	     << "\" NumberOfCells=\"" << nelem << "\">" << endl << "<Points>" << endl << "<DataArray type=\"Float32\" Name=\"Position\" NumberOfComponents=\"3\" format=\"ascii\">" << endl;
+		"<VTKFile type=\"UnstructuredGrid\" version=\"0.1\" byte_order=\"LittleEndian\">\n<UnstructuredGrid>\n" << "<Piece NumberOfPoints=\"" << nn
+	     << "\" NumberOfCells=\"" << nelem << "\">\n" << "<Points>\n" << "<DataArray type=\"Float32\" Name=\"Position\" NumberOfComponents=\"3\" format=\"ascii\">\n";
 
 	double x, y, z;
 	if (dim == 2) {
@@ -69,7 +171,7 @@ void micropp_t::write_vtu(int time_step, int gp_id)
 			for (int i = 0; i < nx; i++) {
 				x = i * dx;
 				y = j * dy;
-				file << x << " " << y << " " << "0.0" << endl;
+				file << x << " " << y << " " << "0.0\n";
 			}
 		}
 	} else if (dim == 3) {
@@ -79,14 +181,14 @@ void micropp_t::write_vtu(int time_step, int gp_id)
 					x = i * dx;
 					y = j * dy;
 					z = k * dz;
-					file << x << " " << y << " " << z << endl;
+					file << x << " " << y << " " << z << "\n";
 				}
 			}
 		}
 	}
-	file << "</DataArray>" << endl << "</Points>" << endl << "<Cells>" << endl;
+	file << "</DataArray>\n" << "</Points>\n" << "<Cells>\n";
 
-	file << "<DataArray type=\"Int32\" Name=\"connectivity\" NumberOfComponents=\"1\" format=\"ascii\">" << endl;
+	file << "<DataArray type=\"Int32\" Name=\"connectivity\" NumberOfComponents=\"1\" format=\"ascii\">\n";
 	if (dim == 2) {
 		for (int ey = 0; ey < ny - 1; ey++) {
 			for (int ex = 0; ex < nx - 1; ex++) {
@@ -94,7 +196,7 @@ void micropp_t::write_vtu(int time_step, int gp_id)
 				int n1 = ey * nx + ex + 1;
 				int n2 = (ey + 1) * nx + ex + 1;
 				int n3 = (ey + 1) * nx + ex;
-				file << n0 << " " << n1 << " " << n2 << " " << n3 << " " << endl;
+				file << n0 << " " << n1 << " " << n2 << " " << n3 << " \n";
 			}
 		}
 	} else if (dim == 3) {
@@ -109,22 +211,22 @@ void micropp_t::write_vtu(int time_step, int gp_id)
 					int n5 = n1 + (nx * ny);
 					int n6 = n2 + (nx * ny);
 					int n7 = n3 + (nx * ny);
-					file << n0 << " " << n1 << " " << n2 << " " << n3 << " " << n4 << " " << n5 << " " << n6 << " " << n7 << " " << endl;
+					file << n0 << " " << n1 << " " << n2 << " " << n3 << " " << n4 << " " << n5 << " " << n6 << " " << n7 << " \n";
 				}
 			}
 		}
 	}
-	file << "</DataArray>" << endl;
+	file << "</DataArray>\n";
 
 	int ce = npe;
-	file << "<DataArray type=\"Int32\" Name=\"offsets\" NumberOfComponents=\"1\" format=\"ascii\">" << endl;
+	file << "<DataArray type=\"Int32\" Name=\"offsets\" NumberOfComponents=\"1\" format=\"ascii\">\n";
 	for (int e = 0; e < nelem; e++) {
 		file << ce << " ";
 		ce += npe;
 	}
-	file << endl << "</DataArray>" << endl;
+	file << "\n</DataArray>\n";
 
-	file << "<DataArray type=\"UInt8\"  Name=\"types\" NumberOfComponents=\"1\" format=\"ascii\">" << endl;
+	file << "<DataArray type=\"UInt8\"  Name=\"types\" NumberOfComponents=\"1\" format=\"ascii\">\n";
 	for (int e = 0; e < nelem; e++) {
 		if (dim == 2) {
 			file << "9 ";
@@ -132,126 +234,162 @@ void micropp_t::write_vtu(int time_step, int gp_id)
 			file << "12 ";
 		}
 	}
-	file << endl;
-	file << "</DataArray>" << endl << "</Cells>" << endl;
+	file << "\n";
+	file << "</DataArray>\n" << "</Cells>\n";
 
-	file << "<PointData Vectors=\"displ,b\" >>" << endl;	// Vectors inside is a filter we should not use this here
-	file << "<DataArray type=\"Float64\" Name=\"displ\" NumberOfComponents=\"3\" format=\"ascii\" >" << endl;
+	file << "<PointData Vectors=\"displ,b\" >>\n";	// Vectors inside is a filter we should not use this here
+	file << "<DataArray type=\"Float64\" Name=\"displ\" NumberOfComponents=\"3\" format=\"ascii\" >\n";
 	for (int n = 0; n < nn; n++) {
 		if (dim == 2) {
-			file << u[n * dim + 0] << " " << u[n * dim + 1] << " 0.0" << endl;
+			file << u[n * dim + 0] << " " << u[n * dim + 1] << " 0.0\n";
 		} else if (dim == 3) {
-			file << u[n * dim + 0] << " " << u[n * dim + 1] << " " << u[n * dim + 2] << endl;
+			file << u[n * dim + 0] << " " << u[n * dim + 1] << " " << u[n * dim + 2] << "\n";
 		}
 	}
-	file << "</DataArray>" << endl;
-	file << "<DataArray type=\"Float64\" Name=\"b\" NumberOfComponents=\"3\" format=\"ascii\" >" << endl;
+	file << "</DataArray>\n";
+	file << "<DataArray type=\"Float64\" Name=\"b\" NumberOfComponents=\"3\" format=\"ascii\" >\n";
 	for (int n = 0; n < nn; n++) {
 		if (dim == 2) {
-			file << b[n * dim + 0] << " " << b[n * dim + 1] << " 0.0" << endl;
+			file << b[n * dim + 0] << " " << b[n * dim + 1] << " 0.0\n";
 		} else if (dim == 3) {
-			file << b[n * dim + 0] << " " << b[n * dim + 1] << " " << b[n * dim + 2] << endl;
+			file << b[n * dim + 0] << " " << b[n * dim + 1] << " " << b[n * dim + 2] << "\n";
 		}
 	}
-	file << "</DataArray>" << endl;
-	file << "</PointData>" << endl;
+	file << "</DataArray>\n";
+	file << "</PointData>\n";
 
-	file << "<CellData>" << endl;
+	file << "<CellData>\n";
 
-	file << "<DataArray type=\"Float64\" Name=\"strain\" NumberOfComponents=\"" << nvoi << "\" format=\"ascii\">" << endl;
+	file << "<DataArray type=\"Float64\" Name=\"strain\" NumberOfComponents=\"" << nvoi << "\" format=\"ascii\">\n";
 	for (int e = 0; e < nelem; e++) {
 		for (int v = 0; v < nvoi; v++)
 			file << elem_strain[e * nvoi + v] << " ";
-		file << endl;
+		file << "\n";
 	}
 	file << "</DataArray>";
 
-	file << "<DataArray type=\"Float64\" Name=\"stress\" NumberOfComponents=\"" << nvoi << "\" format=\"ascii\">" << endl;
+	file << "<DataArray type=\"Float64\" Name=\"stress\" NumberOfComponents=\"" << nvoi << "\" format=\"ascii\">\n";
 	for (int e = 0; e < nelem; e++) {
 		for (int v = 0; v < nvoi; v++)
 			file << elem_stress[e * nvoi + v] << " ";
-		file << endl;
+		file << "\n";
 	}
 	file << "</DataArray>";
 
-	file << "<DataArray type=\"Int32\" Name=\"elem_type\" NumberOfComponents=\"1\" format=\"ascii\">" << endl;
+	file << "<DataArray type=\"Int32\" Name=\"elem_type\" NumberOfComponents=\"1\" format=\"ascii\">\n";
 	for (int e = 0; e < nelem; e++) {
 		file << elem_type[e] << " ";
 	}
-	file << endl << "</DataArray>" << endl;
+	file << "\n</DataArray>\n";
 
-	file << "<DataArray type=\"Float64\" Name=\"plasticity\" NumberOfComponents=\"1\" format=\"ascii\">" << endl;
-	for (int e = 0; e < nelem; e++) {
-		double plasticity = 0.0;
-		if (vars_old != NULL) {
-			if (dim == 3) {
-				for (int gp = 0; gp < 8; gp++) {
-					plasticity +=
-						sqrt(vars_old[intvar_ix(e, gp, 0)] *
-						     vars_old[intvar_ix(e, gp, 0)] +
-						     vars_old[intvar_ix(e, gp, 1)] *
-						     vars_old[intvar_ix(e, gp, 1)] +
-						     vars_old[intvar_ix(e, gp, 2)] *
-						     vars_old[intvar_ix(e, gp, 2)] +
-						     2 * vars_old[intvar_ix(e, gp, 3)] * vars_old[intvar_ix(e, gp, 3)] + 2 * vars_old[intvar_ix(e, gp, 4)] * vars_old[intvar_ix(e, gp, 4)] + 2 * vars_old[intvar_ix(e, gp, 5)] * vars_old[intvar_ix(e, gp, 5)]);
-				}
-			}
-		}
-		file << plasticity / 8 << " ";
-	}
-	file << endl << "</DataArray>" << endl;
+	file << "<DataArray type=\"Float64\" Name=\"plasticity\" NumberOfComponents=\"1\" format=\"ascii\">\n";
+	for (int e = 0; e < nelem; e++)
+		file << snap.plasticity[e] << " ";
+	file << "\n</DataArray>\n";
 
-	file << "<DataArray type=\"Float64\" Name=\"hardening\" NumberOfComponents=\"1\" format=\"ascii\">" << endl;
-	for (int e = 0; e < nelem; e++) {
-		double hardening = 0.0;
-		if (vars_old != NULL) {
-			if (dim == 3) {
-				for (int gp = 0; gp < 8; gp++) {
-					hardening += vars_old[intvar_ix(e, gp, 6)];
-				}
-			}
-		}
-		file << hardening / 8 << " ";
-	}
-	file << endl << "</DataArray>" << endl;
+	file << "<DataArray type=\"Float64\" Name=\"hardening\" NumberOfComponents=\"1\" format=\"ascii\">\n";
+	for (int e = 0; e < nelem; e++)
+		file << snap.hardening[e] << " ";
+	file << "\n</DataArray>\n";
 
-	file << "</CellData>" << endl;
-	file << "</Piece>" << endl << "</UnstructuredGrid>" << endl << "</VTKFile>" << endl;
+	file << "</CellData>\n";
+	file << "</Piece>\n" << "</UnstructuredGrid>\n" << "</VTKFile>\n";
 
 	file.close();
 }
 
 void micropp_t::write_info_files()
 {
-	ofstream file;
-	if (output_files_header == false) {
-		output_files_header = true;
+	shared_ptr<info_snapshot_t> snap = make_shared<info_snapshot_t>();
+	take_info_snapshot(*snap, INFO_VARS_ALL);
+	snap->header = !output_files_header;
+	output_files_header = true;
+
+	io_submit([this, snap] { write_info_snapshot(*snap); });
+}
+
+void micropp_t::take_info_snapshot(info_snapshot_t &snap, const int vars_rows)
+{
+	// vars_rows : int_vars of all the points, of the non-linear ones
+	// or of none (INFO_VARS_ALL, INFO_VARS_NL, INFO_VARS_NONE)
+	const int ngp = gauss_list.size();
+	snap.header = false;
+	snap.sur_on = sur_on;
+	snap.ngp = ngp;
+	snap.id.resize(ngp);
+	snap.nl_flag.resize(ngp);
+	snap.nr_its.resize(ngp * 7);
+	snap.inv_max.resize(ngp);
+	snap.nr_err.resize(ngp * 7);
+	snap.strain.resize(ngp * nvoi);
+	snap.stress.resize(ngp * nvoi);
+	snap.ctan.resize(ngp * nvoi * nvoi);
+	snap.vars_ix.clear();
+	snap.sur_served = sur_served;
+	snap.sur_solved = sur_solved;
+	snap.sur_n = sur_n;
+
+	for (int p = 0; p < ngp; ++p) {
+		const gp_t &gp = gauss_list[p];
+		snap.id[p] = gp.id;
+		snap.nl_flag[p] = (gp.int_vars_n == NULL && gp.int_vars_c == NULL &&
+		                   gp.rom_vars_n == NULL && gp.table_eps_n == NULL) ? 0 : 1;
+		snap.inv_max[p] = gp.inv_max;
+		for (int i = 0; i < 7; ++i) {
+			snap.nr_its[p * 7 + i] = gp.nr_its[i];
+			snap.nr_err[p * 7 + i] = gp.nr_err[i];
+		}
+		for (int i = 0; i < nvoi; ++i) {
+			snap.strain[p * nvoi + i] = gp.macro_strain[i];
+			snap.stress[p * nvoi + i] = gp.macro_stress[i];
+		}
+		for (int i = 0; i < nvoi * nvoi; ++i)
+			snap.ctan[p * nvoi * nvoi + i] = gp.macro_ctan[i];
+		if (vars_rows == INFO_VARS_ALL ||
+		    (vars_rows == INFO_VARS_NL && (gp.int_vars_n != NULL || gp.int_vars_c != NULL)))
+			snap.vars_ix.push_back(p);
+	}
+
+	snap.int_vars.resize(snap.vars_ix.size() * num_int_vars);
+	for (size_t r = 0; r < snap.vars_ix.size(); ++r)
+		load_int_vars_n(gauss_list[snap.vars_ix[r]], &snap.int_vars[r * num_int_vars]);
+}
 
+void micropp_t::write_info_snapshot(const info_snapshot_t &snap)
+{
+	ofstream file;
+	if (snap.header) {
 		file.open("micropp_convergence.dat", std::ios_base::app);
 		file << "# gp_id : ";
-		for (auto const &gp:gauss_list)
-			file << gp.id << " ";
+		for (int p = 0; p < snap.ngp; ++p)
+			file << snap.id[p] << " ";
 		file << endl;
 		file << "# nl_flag [1] # inv_max [2] # inv_tol [3]" << endl << "# nr_its  [4] # nr_tol  [5]" << endl;
 		file.close();
 
+		if (snap.sur_on) {
+			file.open("micropp_surrogate.dat", std::ios_base::app);
+			file << "# served [1] # solved [2] # served fraction [3] # training points [4]" << endl;
+			file.close();
+		}
+
 		file.open("micropp_eps_sig_ctan.dat", std::ios_base::app);
 		file << "# gp_id : ";
-		for (auto const &gp:gauss_list)
-			file << gp.id << " ";
+		for (int p = 0; p < snap.ngp; ++p)
+			file << snap.id[p] << " ";
 		file << "# epsxx [1] # epsyy [2] # epszz[3] # epsxy[4] # epsxz[5] # epsyz[6]" << "# sigxx [7] # sigyy [2] # sigzz[3] # sigxy[4] # sigxz[5] # sigyz[6]" << endl;
 		file << endl;
 		file.close();
 	}
 
 	file.open("micropp_convergence.dat", std::ios_base::app);
-	for (auto const &gp:gauss_list) {
+	for (int p = 0; p < snap.ngp; ++p) {
 		file << scientific;
-		file << setw(3) << ((gp.int_vars_n == NULL) ? 0 : 1) << " ";
-		file << setw(14) << gp.inv_max << " ";
+		file << setw(3) << snap.nl_flag[p] << " ";
+		file << setw(14) << snap.inv_max[p] << " ";
 		for (int i = 0; i < (1 + nvoi); ++i) {
-			file << setw(14) << gp.nr_its[i] << " ";
-			file << setw(14) << gp.nr_err[i] << " ";
+			file << setw(14) << snap.nr_its[p * 7 + i] << " ";
+			file << setw(14) << snap.nr_err[p * 7 + i] << " ";
 		}
 		file << " | ";
 	}
@@ -259,25 +397,33 @@ void micropp_t::write_info_files()
 	file.close();
 
 	file.open("micropp_eps_sig_ctan.dat", std::ios_base::app);
-	for (auto const &gp:gauss_list) {
+	for (int p = 0; p < snap.ngp; ++p) {
+		// 6 / 36 columns as in 3D, the 2D rows are padded with zeros
 		for (int i = 0; i < 6; ++i)
-			file << setw(14) << gp.macro_strain[i] << " ";
+			file << setw(14) << ((i < nvoi) ? snap.strain[p * nvoi + i] : 0.0) << " ";
 		for (int i = 0; i < 6; ++i)
-			file << setw(14) << gp.macro_stress[i] << " ";
+			file << setw(14) << ((i < nvoi) ? snap.stress[p * nvoi + i] : 0.0) << " ";
 		for (int i = 0; i < 36; ++i)
-			file << setw(14) << gp.macro_ctan[i] << " ";
+			file << setw(14) << ((i < nvoi * nvoi) ? snap.ctan[p * nvoi * nvoi + i] : 0.0) << " ";
 		file << " | ";
 	}
 	file << endl;
 	file.close();
 
+	if (snap.sur_on) {
+		file.open("micropp_surrogate.dat", std::ios_base::app);
+		const int total = snap.sur_served + snap.sur_solved;
+		file << setw(8) << snap.sur_served << " " << setw(8) << snap.sur_solved << " "
+		     << setw(14) << ((total > 0) ? (double) snap.sur_served / total : 0.0)
+		     << " " << setw(8) << snap.sur_n << endl;
+		file.close();
+	}
+
 	file.open("micropp_int_vars_n.dat", std::ios_base::app);
-	for (auto const &gp:gauss_list) {
+	for (size_t r = 0; r < snap.vars_ix.size(); ++r) {
+		const double *int_vars = &snap.int_vars[r * num_int_vars];
 		for (int i = 0; i < num_int_vars; ++i)
-			if (gp.int_vars_n != NULL)
-				file << setw(14) << gp.int_vars_n[i] << " ";
-			else
-				file << setw(14) << 0.0 << " ";
+			file << setw(14) << int_vars[i] << " ";
 		file << " | ";
 	}
 	file << endl;
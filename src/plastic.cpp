@@ -0,0 +1,113 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Return mapping of the 8 Gauss points of an element at once. The int_vars
+ * of an element are stored by variable (intvar_ix), so every variable of
+ * the 8 points is one vector load. The lanes that yield and the elastic
+ * ones follow the same instructions and the result is selected by a mask.
+ */
+
+#include <cmath>
+
+#include "micro.hpp"
+#include "simd.hpp"
+
+void micropp_t::get_elem_stress3D(int ex, int ey, int ez, const double strain[6][8],
+                                  bool *non_linear, double stress[6][8])
+{
+	const int e = glo_elem3D(ex, ey, ez);
+	const int m = elem_mat[e];
+	*non_linear = false;
+
+	if (mats.plasticity[m] == true) {
+		plastic_step_8(m, strain, &vars_old[intvar_ix(e, 0, 0)],
+		               &vars_new[intvar_ix(e, 0, 0)], non_linear, stress);
+		return;
+	}
+
+	const double lambda = mats.lambda[m], mu = mats.mu[m];
+	double tr[8];
+	for (int gp = 0; gp < 8; ++gp)
+		tr[gp] = strain[0][gp] + strain[1][gp] + strain[2][gp];
+	for (int i = 0; i < 3; ++i)
+		for (int gp = 0; gp < 8; ++gp)
+			stress[i][gp] = lambda * tr[gp] + 2 * mu * strain[i][gp];
+	for (int i = 3; i < 6; ++i)
+		for (int gp = 0; gp < 8; ++gp)
+			stress[i][gp] = mu * strain[i][gp];
+}
+
+void micropp_t::plastic_step_8(const int mat, const double eps[6][8], const double *vars_old_e,
+                               double *vars_new_e, bool *non_linear, double stress[6][8])
+{
+	// vars_*_e : the 8 * INT_VARS_GP variables of the element
+	const double mu_s = mats.mu[mat], Ka_s = mats.Ka[mat];
+	const vd mu = vset(mu_s), mu2 = vset(2 * mu_s), k = vset(mats.k[mat]);
+	const vd Sy = vset(mats.Sy[mat]), Ka = vset(Ka_s);
+	const vd c = vset(2 * mu_s * (1.0 + (0.0 * Ka_s) / (3 * mu_s)));
+	const vd r23 = vset(sqrt(2.0 / 3)), third = vset(1 / 3.0);
+	const vd zero = vset(0.0), one = vset(1.0), two = vset(2.0);
+
+	bool nl = false;
+	for (int l = 0; l < 8; l += VW) {
+
+		vd e[6], ep[6], s[6];
+		for (int i = 0; i < 6; ++i) {
+			e[i] = vload(&eps[i][l]);
+			ep[i] = vload(&vars_old_e[i * 8 + l]);
+		}
+		const vd alpha = vload(&vars_old_e[6 * 8 + l]);
+
+		// Deviatoric trial stress
+		const vd tr = vadd(vadd(e[0], e[1]), e[2]);
+		const vd tr_p = vadd(vadd(ep[0], ep[1]), ep[2]);
+		for (int i = 0; i < 3; ++i)
+			s[i] = vmul(mu2, vsub(vsub(e[i], vmul(third, tr)),
+			                      vsub(ep[i], vmul(third, tr_p))));
+		for (int i = 3; i < 6; ++i)
+			s[i] = vmul(mu, vsub(e[i], ep[i]));
+
+		vd norm = vmul(s[0], s[0]);
+		norm = vadd(norm, vmul(s[1], s[1]));
+		norm = vadd(norm, vmul(s[2], s[2]));
+		for (int i = 3; i < 6; ++i)
+			norm = vadd(norm, vmul(vmul(two, s[i]), s[i]));
+		norm = vsqrt(norm);
+
+		const vd f_trial = vsub(norm, vmul(r23, vadd(Sy, vmul(Ka, alpha))));
+		const vm yield = vgt(f_trial, zero);
+		nl = nl || vany(yield);
+
+		// dl and the normal are 0 in the elastic lanes
+		const vd dl = vsel(yield, vdiv(f_trial, c), zero);
+		const vd inv_norm = vsel(yield, vdiv(one, norm), zero);
+		const vd mu2_dl = vmul(mu2, dl);
+
+		for (int i = 0; i < 6; ++i) {
+			const vd normal = vmul(s[i], inv_norm);
+			vstore(&vars_new_e[i * 8 + l], vadd(ep[i], vmul(dl, normal)));
+			const vd sig = (i < 3) ? vadd(s[i], vmul(k, tr)) : s[i];
+			vstore(&stress[i][l], vsub(sig, vmul(mu2_dl, normal)));
+		}
+		vstore(&vars_new_e[6 * 8 + l], vadd(alpha, vmul(r23, dl)));
+	}
+	*non_linear = nl;
+}
@@ -0,0 +1,530 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * POD/Galerkin reduced model of the RVE with empirical cubature
+ *
+ * Offline : the displacement fluctuations u - E.x of the full solves
+ * (zero on the boundary) are compressed with the method of snapshots
+ * into nmodes orthonormal modes phi_k. The empirical cubature method
+ * then picks a few Gauss points x_z with positive weights w_z that
+ * integrate, as the full rule does, the snapshot internal forces
+ * (B phi_k)^t sig_s, the snapshot stresses and the volume.
+ *
+ * Online : u = E.x + sum_k q_k phi_k and the nmodes equations
+ *
+ *     r_k = sum_z w_z (B phi_k)(x_z)^t sig(E + B phi q, x_z) = 0
+ *
+ * are solved with Newton iterations on a dense nmodes x nmodes system.
+ * Only the cubature points carry internal variables.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#include "micro.hpp"
+
+#define nod_index(i,j,k) ((k)*nx*ny + (j)*nx + (i))
+
+#define POD_JACOBI_SWEEPS 60
+#define POD_NR_MAX_TOL 1.0e-10
+#define POD_NR_MAX_ITS 30
+
+static void eig_sym(const int n, double *a, double *w, double *v)
+{
+	// Cyclic Jacobi, a is overwritten. The eigenvalues are left in w in
+	// descending order and their vectors in the columns of v.
+	vector<double> vj(n * n);
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j)
+			vj[i * n + j] = (i == j) ? 1.0 : 0.0;
+
+	for (int sweep = 0; sweep < POD_JACOBI_SWEEPS; ++sweep) {
+
+		double off = 0.0, diag = 0.0;
+		for (int i = 0; i < n; ++i) {
+			diag += a[i * n + i] * a[i * n + i];
+			for (int j = i + 1; j < n; ++j)
+				off += a[i * n + j] * a[i * n + j];
+		}
+		if (off <= 1.0e-30 * diag)
+			break;
+
+		for (int p = 0; p < n; ++p) {
+			for (int q = p + 1; q < n; ++q) {
+				const double apq = a[p * n + q];
+				if (apq == 0.0)
+					continue;
+				const double theta = (a[q * n + q] - a[p * n + p]) / (2.0 * apq);
+				const double t = ((theta >= 0.0) ? 1.0 : -1.0) /
+					(fabs(theta) + sqrt(theta * theta + 1.0));
+				const double c = 1.0 / sqrt(t * t + 1.0);
+				const double s = t * c;
+
+				for (int k = 0; k < n; ++k) {
+					const double akp = a[k * n + p], akq = a[k * n + q];
+					a[k * n + p] = c * akp - s * akq;
+					a[k * n + q] = s * akp + c * akq;
+				}
+				for (int k = 0; k < n; ++k) {
+					const double apk = a[p * n + k], aqk = a[q * n + k];
+					a[p * n + k] = c * apk - s * aqk;
+					a[q * n + k] = s * apk + c * aqk;
+				}
+				for (int k = 0; k < n; ++k) {
+					const double vkp = vj[k * n + p], vkq = vj[k * n + q];
+					vj[k * n + p] = c * vkp - s * vkq;
+					vj[k * n + q] = s * vkp + c * vkq;
+				}
+			}
+		}
+	}
+
+	vector<int> perm(n);
+	for (int i = 0; i < n; ++i)
+		perm[i] = i;
+	sort(perm.begin(), perm.end(),
+	     [&](int i, int j) { return a[i * n + i] > a[j * n + j]; });
+
+	for (int j = 0; j < n; ++j) {
+		w[j] = a[perm[j] * n + perm[j]];
+		for (int i = 0; i < n; ++i)
+			v[i * n + j] = vj[i * n + perm[j]];
+	}
+}
+
+static int truncate_energy(const int n, const double *lam, const int nmax, const double tol)
+{
+	// Number of leading eigenvalues leaving a relative (2-norm) error <= tol
+	double total = 0.0;
+	for (int i = 0; i < n; ++i)
+		total += max(lam[i], 0.0);
+
+	int m = 0;
+	double energy = 0.0;
+	while (m < min(n, nmax) && lam[m] > 1.0e-14 * lam[0] &&
+	       energy < (1.0 - tol * tol) * total)
+		energy += lam[m++];
+	return m;
+}
+
+void micropp_t::set_pod_snapshots(const bool on)
+{
+	assert(dim == 3);
+	pod_snap_on = on;
+}
+
+void micropp_t::pod_add_snapshot(const double *macro_strain)
+{
+	const int ndof = nn * dim;
+	const double *eps = macro_strain;
+
+	pod_snap_u.resize((pod_nsnap + 1) * ndof);
+	pod_snap_s.resize((pod_nsnap + 1) * nelem * 8 * 6);
+	double *snap_u = &pod_snap_u[pod_nsnap * ndof];
+	double *snap_s = &pod_snap_s[pod_nsnap * nelem * 8 * 6];
+
+	for (int k = 0; k < nz; ++k) {
+		for (int j = 0; j < ny; ++j) {
+			for (int i = 0; i < nx; ++i) {
+				const int n = nod_index(i, j, k);
+				const double xcoor = i * dx;
+				const double ycoor = j * dy;
+				const double zcoor = k * dz;
+				snap_u[n * dim] = u[n * dim] -
+					(eps[0] * xcoor + 0.5 * eps[3] * ycoor + 0.5 * eps[4] * zcoor);
+				snap_u[n * dim + 1] = u[n * dim + 1] -
+					(0.5 * eps[3] * xcoor + eps[1] * ycoor + 0.5 * eps[5] * zcoor);
+				snap_u[n * dim + 2] = u[n * dim + 2] -
+					(0.5 * eps[4] * xcoor + 0.5 * eps[5] * ycoor + eps[2] * zcoor);
+			}
+		}
+	}
+
+	// vars_old still holds the state of the point being solved
+	for (int ex = 0; ex < nx - 1; ex++) {
+		for (int ey = 0; ey < ny - 1; ey++) {
+			for (int ez = 0; ez < nz - 1; ez++) {
+				const int e = glo_elem3D(ex, ey, ez);
+				for (int gp = 0; gp < 8; gp++) {
+					bool nl_flag;
+					double strain_gp[6];
+					get_strain3D(ex, ey, ez, gp, strain_gp);
+					get_stress3D(ex, ey, ez, gp, strain_gp, &nl_flag,
+					             &snap_s[(e * 8 + gp) * 6]);
+				}
+			}
+		}
+	}
+
+	pod_nsnap++;
+}
+
+void micropp_t::calc_pod(const int nmodes, const double tol)
+{
+	assert(dim == 3 && pod_nsnap > 0 && nmodes >= 0);
+
+	const int ns = pod_nsnap;
+	const int ndof = nn * dim;
+	const int ncol = nelem * 8;
+
+	// Method of snapshots : eigenpairs of the snapshot Gram matrix
+	vector<double> gram(ns * ns), lam(ns), vec(ns * ns);
+	for (int i = 0; i < ns; ++i)
+		for (int j = 0; j <= i; ++j) {
+			double sum = 0.0;
+			for (int d = 0; d < ndof; ++d)
+				sum += pod_snap_u[i * ndof + d] * pod_snap_u[j * ndof + d];
+			gram[i * ns + j] = gram[j * ns + i] = sum;
+		}
+	eig_sym(ns, gram.data(), lam.data(), vec.data());
+
+	const int m = truncate_energy(ns, lam.data(), nmodes, tol);
+	pod_nmodes = m;
+	pod_phi.assign(m * ndof, 0.0);
+	for (int k = 0; k < m; ++k) {
+		const double f = 1.0 / sqrt(lam[k]);
+		for (int s = 0; s < ns; ++s)
+			for (int d = 0; d < ndof; ++d)
+				pod_phi[k * ndof + d] += vec[s * ns + k] * f * pod_snap_u[s * ndof + d];
+	}
+
+	// Integrand matrix, one column per Gauss point
+	const int nrow = ns * m + ns * 6 + 1;
+	const double wg = (1 / 8.0) * dx * dy * dz;
+	vector<double> G(nrow * ncol), bphi(6 * m);
+
+	for (int ex = 0; ex < nx - 1; ex++) {
+		for (int ey = 0; ey < ny - 1; ey++) {
+			for (int ez = 0; ez < nz - 1; ez++) {
+
+				const int e = glo_elem3D(ex, ey, ez);
+				const int n0 = ez * (nx * ny) + ey * nx + ex;
+				const int nodes[8] = { n0, n0 + 1, n0 + nx + 1, n0 + nx,
+				                       n0 + nx * ny, n0 + nx * ny + 1,
+				                       n0 + nx * ny + nx + 1, n0 + nx * ny + nx };
+
+				for (int gp = 0; gp < 8; ++gp) {
+					const int c = e * 8 + gp;
+					double bmat[6][3 * 8];
+					calc_bmat_3D(gp, bmat);
+
+					for (int v = 0; v < 6; ++v)
+						for (int k = 0; k < m; ++k) {
+							double sum = 0.0;
+							for (int a = 0; a < 8; ++a)
+								for (int d = 0; d < dim; ++d)
+									sum += bmat[v][a * dim + d] *
+										pod_phi[k * ndof + nodes[a] * dim + d];
+							bphi[v * m + k] = sum;
+						}
+
+					for (int s = 0; s < ns; ++s) {
+						const double *sig = &pod_snap_s[(s * ncol + c) * 6];
+						for (int k = 0; k < m; ++k) {
+							double sum = 0.0;
+							for (int v = 0; v < 6; ++v)
+								sum += bphi[v * m + k] * sig[v];
+							G[(s * m + k) * ncol + c] = sum;
+						}
+						for (int v = 0; v < 6; ++v)
+							G[(ns * m + s * 6 + v) * ncol + c] = sig[v];
+					}
+					G[(nrow - 1) * ncol + c] = 1.0;
+				}
+			}
+		}
+	}
+
+	for (int r = 0; r < nrow; ++r) {
+		double norm = 0.0;
+		for (int c = 0; c < ncol; ++c)
+			norm += G[r * ncol + c] * G[r * ncol + c];
+		if (norm > 0.0)
+			for (int c = 0; c < ncol; ++c)
+				G[r * ncol + c] /= sqrt(norm);
+	}
+
+	// Orthogonal basis of the row space (truncated SVD of G)
+	vector<double> ggt(nrow * nrow), mu(nrow), U(nrow * nrow);
+	for (int i = 0; i < nrow; ++i)
+		for (int j = 0; j <= i; ++j) {
+			double sum = 0.0;
+			for (int c = 0; c < ncol; ++c)
+				sum += G[i * ncol + c] * G[j * ncol + c];
+			ggt[i * nrow + j] = ggt[j * nrow + i] = sum;
+		}
+	eig_sym(nrow, ggt.data(), mu.data(), U.data());
+	const int p = truncate_energy(nrow, mu.data(), ncol, tol);
+
+	vector<double> Gp(p * ncol, 0.0), bp(p, 0.0), norm_col(ncol, 0.0);
+	for (int i = 0; i < p; ++i)
+		for (int r = 0; r < nrow; ++r) {
+			const double f = U[r * nrow + i];
+			for (int c = 0; c < ncol; ++c)
+				Gp[i * ncol + c] += f * G[r * ncol + c];
+		}
+	for (int i = 0; i < p; ++i)
+		for (int c = 0; c < ncol; ++c) {
+			bp[i] += Gp[i * ncol + c] * wg;
+			norm_col[c] += Gp[i * ncol + c] * Gp[i * ncol + c];
+		}
+	double norm_b = 0.0;
+	for (int i = 0; i < p; ++i)
+		norm_b += bp[i] * bp[i];
+	norm_b = sqrt(norm_b);
+
+	// Greedy empirical cubature with positive weights
+	vector<int> sel;
+	vector<double> alpha, res(bp);
+	vector<bool> banned(ncol, false);
+
+	while ((int) sel.size() < p) {
+
+		double norm_r = 0.0;
+		for (int i = 0; i < p; ++i)
+			norm_r += res[i] * res[i];
+		if (sqrt(norm_r) <= tol * norm_b)
+			break;
+
+		int best = -1;
+		double best_val = 0.0;
+		for (int c = 0; c < ncol; ++c) {
+			if (banned[c] || norm_col[c] == 0.0)
+				continue;
+			double val = 0.0;
+			for (int i = 0; i < p; ++i)
+				val += Gp[i * ncol + c] * res[i];
+			val /= sqrt(norm_col[c]);
+			if (val > best_val) {
+				best_val = val;
+				best = c;
+			}
+		}
+		if (best < 0)
+			break;
+		sel.push_back(best);
+		banned[best] = true;
+
+		while (true) {
+			// Least squares weights of the selected points
+			const int ns_z = sel.size();
+			vector<double> mat(ns_z * ns_z), rhs(ns_z);
+			double trace = 0.0;
+			for (int a = 0; a < ns_z; ++a) {
+				for (int b = 0; b < ns_z; ++b) {
+					double sum = 0.0;
+					for (int i = 0; i < p; ++i)
+						sum += Gp[i * ncol + sel[a]] * Gp[i * ncol + sel[b]];
+					mat[a * ns_z + b] = sum;
+				}
+				rhs[a] = 0.0;
+				for (int i = 0; i < p; ++i)
+					rhs[a] += Gp[i * ncol + sel[a]] * bp[i];
+				trace += mat[a * ns_z + a];
+			}
+			for (int a = 0; a < ns_z; ++a)
+				mat[a * ns_z + a] += 1.0e-14 * trace / ns_z;
+			solve_dense(ns_z, mat.data(), rhs.data());
+			alpha = rhs;
+
+			vector<int> sel_n;
+			for (int a = 0; a < ns_z; ++a)
+				if (alpha[a] > 0.0)
+					sel_n.push_back(sel[a]);
+			if (sel_n.size() == sel.size())
+				break;
+			sel.swap(sel_n);
+		}
+
+		for (int i = 0; i < p; ++i) {
+			res[i] = bp[i];
+			for (int a = 0; a < (int) sel.size(); ++a)
+				res[i] -= Gp[i * ncol + sel[a]] * alpha[a];
+		}
+	}
+
+	// Reduced rule
+	pod_npts = sel.size();
+	pod_w = alpha;
+	pod_w.resize(pod_npts);
+	pod_mat.resize(pod_npts);
+	pod_bphi.resize(pod_npts * 6 * m);
+	pod_vol = 0.0;
+
+	for (int z = 0; z < pod_npts; ++z) {
+		const int e = sel[z] / 8, gp = sel[z] % 8;
+		const int ex = e % (nx - 1);
+		const int ey = (e / (nx - 1)) % (ny - 1);
+		const int ez = e / ((nx - 1) * (ny - 1));
+		const int n0 = ez * (nx * ny) + ey * nx + ex;
+		const int nodes[8] = { n0, n0 + 1, n0 + nx + 1, n0 + nx,
+		                       n0 + nx * ny, n0 + nx * ny + 1,
+		                       n0 + nx * ny + nx + 1, n0 + nx * ny + nx };
+
+		double bmat[6][3 * 8];
+		calc_bmat_3D(gp, bmat);
+		for (int v = 0; v < 6; ++v)
+			for (int k = 0; k < m; ++k) {
+				double sum = 0.0;
+				for (int a = 0; a < 8; ++a)
+					for (int d = 0; d < dim; ++d)
+						sum += bmat[v][a * dim + d] *
+							pod_phi[k * ndof + nodes[a] * dim + d];
+				pod_bphi[(z * 6 + v) * m + k] = sum;
+			}
+
+		pod_mat[z] = elem_mat[e];
+		pod_vol += pod_w[z];
+	}
+
+	pod_nsnap = 0;
+	vector<double>().swap(pod_snap_u);
+	vector<double>().swap(pod_snap_s);
+}
+
+void micropp_t::set_pod(const bool on)
+{
+	assert(!on || pod_npts > 0);
+	pod_on = on;
+	if (on)
+		rom_on = false;
+}
+
+void micropp_t::get_pod_size(int *nmodes, int *npts)
+{
+	*nmodes = pod_nmodes;
+	*npts = pod_npts;
+}
+
+void micropp_t::pod_solve(const double *macro_strain, const double *vars_n, double *vars_k,
+                          double *macro_stress, bool *non_linear, int *its, double *err)
+{
+	const int m = pod_nmodes;
+	const int np = pod_npts;
+	const double d_eps = 1.0e-8;
+
+	vector<double> q(m, 0.0), r(m), jac(m * m), cb(6 * m);
+	vector<double> eps(np * 6), eps_p(np * 6), alpha(np), stress(np * 6);
+
+	*its = 0;
+	*err = 0.0;
+	while (true) {
+
+		double scale = 0.0;
+		*non_linear = false;
+		for (int k = 0; k < m; ++k)
+			r[k] = 0.0;
+
+		for (int z = 0; z < np; ++z) {
+			const double *bphi = &pod_bphi[z * 6 * m];
+			const double *vars_z = (vars_n != NULL) ? &vars_n[z * INT_VARS_GP] : NULL;
+
+			for (int v = 0; v < 6; ++v) {
+				eps[z * 6 + v] = macro_strain[v];
+				for (int k = 0; k < m; ++k)
+					eps[z * 6 + v] += bphi[v * m + k] * q[k];
+			}
+
+			bool nl;
+			rom_point_stress(pod_mat[z], &eps[z * 6], vars_z, &eps_p[z * 6], &alpha[z],
+			                 &nl, &stress[z * 6]);
+			*non_linear = *non_linear || nl;
+
+			double norm_b = 0.0, norm_s = 0.0;
+			for (int v = 0; v < 6; ++v) {
+				norm_s += stress[z * 6 + v] * stress[z * 6 + v];
+				for (int k = 0; k < m; ++k) {
+					r[k] += pod_w[z] * bphi[v * m + k] * stress[z * 6 + v];
+					norm_b += bphi[v * m + k] * bphi[v * m + k];
+				}
+			}
+			scale += pod_w[z] * sqrt(norm_b * norm_s);
+		}
+
+		*err = 0.0;
+		for (int k = 0; k < m; ++k)
+			*err += r[k] * r[k];
+		*err = sqrt(*err);
+
+		if (*err <= POD_NR_MAX_TOL * (scale + 1.0e-30) || *its >= POD_NR_MAX_ITS)
+			break;
+
+		// J = sum_z w_z (B phi)^t C_z (B phi) with C_z by perturbation
+		for (int i = 0; i < m * m; ++i)
+			jac[i] = 0.0;
+
+		for (int z = 0; z < np; ++z) {
+			const double *bphi = &pod_bphi[z * 6 * m];
+			const double *vars_z = (vars_n != NULL) ? &vars_n[z * INT_VARS_GP] : NULL;
+
+			double ctan[6][6];
+			for (int j = 0; j < 6; ++j) {
+				double eps_pert[6], eps_p_pert[6], alpha_pert, stress_pert[6];
+				bool nl;
+				for (int v = 0; v < 6; ++v)
+					eps_pert[v] = eps[z * 6 + v];
+				eps_pert[j] += d_eps;
+				rom_point_stress(pod_mat[z], eps_pert, vars_z, eps_p_pert, &alpha_pert,
+				                 &nl, stress_pert);
+				for (int v = 0; v < 6; ++v)
+					ctan[v][j] = (stress_pert[v] - stress[z * 6 + v]) / d_eps;
+			}
+
+			for (int v = 0; v < 6; ++v)
+				for (int k = 0; k < m; ++k) {
+					cb[v * m + k] = 0.0;
+					for (int j = 0; j < 6; ++j)
+						cb[v * m + k] += ctan[v][j] * bphi[j * m + k];
+				}
+
+			for (int k = 0; k < m; ++k)
+				for (int l = 0; l < m; ++l) {
+					double sum = 0.0;
+					for (int v = 0; v < 6; ++v)
+						sum += bphi[v * m + k] * cb[v * m + l];
+					jac[k * m + l] += pod_w[z] * sum;
+				}
+		}
+
+		for (int k = 0; k < m; ++k)
+			r[k] = -r[k];
+		solve_dense(m, jac.data(), r.data());
+		for (int k = 0; k < m; ++k)
+			q[k] += r[k];
+		(*its)++;
+	}
+
+	for (int v = 0; v < nvoi; ++v) {
+		macro_stress[v] = 0.0;
+		for (int z = 0; z < np; ++z)
+			macro_stress[v] += pod_w[z] * stress[z * 6 + v];
+		macro_stress[v] /= pod_vol;
+	}
+
+	if (vars_k != NULL)
+		for (int z = 0; z < np; ++z) {
+			for (int v = 0; v < 6; ++v)
+				vars_k[z * INT_VARS_GP + v] = eps_p[z * 6 + v];
+			vars_k[z * INT_VARS_GP + 6] = alpha[z];
+		}
+}
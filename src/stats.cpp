@@ -0,0 +1,197 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * In-situ statistics of the solved points. The converged stress pass of
+ * solve_gp leaves the stress and alpha of every integration point in
+ * stats_ip and calc_stats reduces them to the record
+ *
+ *     numMaterials x { volume fraction, average stress (nvoi),
+ *                      max von Mises, plastic volume fraction }
+ *     STATS_BINS volume fractions of von Mises / max von Mises
+ *     von Mises averaged over blocks of stride^dim elements (if stride > 0)
+ *
+ * The stats file (native byte order) is
+ *
+ *     char magic[8] = STATS_MAGIC, int32 version, nvoi, materials, bins,
+ *     stride, ncoarse[3], rec_size,
+ *     records { int32 time_step, gp_id, double rec[rec_size] }
+ */
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+#define STATS_MAGIC   "MICROPPS"
+#define STATS_VERSION 2
+
+double micropp_t::get_von_mises(const double *stress)
+{
+	if (dim == 2)
+		return sqrt(stress[0] * stress[0] - stress[0] * stress[1] +
+		            stress[1] * stress[1] + 3 * stress[2] * stress[2]);
+
+	return sqrt(0.5 * ((stress[0] - stress[1]) * (stress[0] - stress[1]) +
+	                   (stress[1] - stress[2]) * (stress[1] - stress[2]) +
+	                   (stress[2] - stress[0]) * (stress[2] - stress[0])) +
+	            3 * (stress[3] * stress[3] + stress[4] * stress[4] +
+	                 stress[5] * stress[5]));
+}
+
+bool micropp_t::open_stats(const char *fname, const int stride)
+{
+	assert(stride >= 0);
+	close_stats();
+
+	stats_file = fopen(fname, "wb");
+	if (stats_file == NULL) {
+		cerr << "micropp : can not open " << fname << endl;
+		return false;
+	}
+
+	stats_on = true;
+	stats_stride = stride;
+	const int nex[3] = { nx - 1, ny - 1, (dim == 3) ? nz - 1 : 1 };
+	for (int d = 0; d < 3; ++d)
+		stats_ncoarse[d] = (stride > 0) ? (nex[d] + stride - 1) / stride : 0;
+	stats_ip.assign(nelem * npe * (nvoi + 1), 0.0);
+	stats_id.clear();
+	stats_rec.clear();
+
+	const int32_t head[9] = { STATS_VERSION, nvoi, numMaterials, STATS_BINS, stride,
+	                          stats_ncoarse[0], stats_ncoarse[1], stats_ncoarse[2],
+	                          get_stats_size() };
+	fwrite(STATS_MAGIC, 1, 8, stats_file);
+	fwrite(head, sizeof(int32_t), 9, stats_file);
+	return true;
+}
+
+void micropp_t::close_stats()
+{
+	io_flush();
+	if (stats_file != NULL)
+		fclose(stats_file);
+	stats_file = NULL;
+	stats_on = false;
+	stats_ip.clear();
+	stats_id.clear();
+	stats_rec.clear();
+}
+
+int micropp_t::get_stats_size()
+{
+	return numMaterials * (3 + nvoi) + STATS_BINS +
+		stats_ncoarse[0] * stats_ncoarse[1] * stats_ncoarse[2];
+}
+
+void micropp_t::calc_stats(const gp_t &gp)
+{
+	const int rec_size = get_stats_size();
+	const int ncoarse = stats_ncoarse[0] * stats_ncoarse[1] * stats_ncoarse[2];
+	const double wg = 1.0 / (nelem * npe);	// the integration points weigh the same
+
+	stats_id.push_back(gp.id);
+	stats_rec.resize(stats_rec.size() + rec_size, 0.0);
+	double *rec = &stats_rec[stats_rec.size() - rec_size];
+	double *hist = rec + numMaterials * (3 + nvoi);
+	double *coarse = hist + STATS_BINS;
+
+	vector<double> vm(nelem * npe);
+	double vm_max = 0.0;
+	for (int i = 0; i < nelem * npe; ++i) {
+		vm[i] = get_von_mises(&stats_ip[i * (nvoi + 1)]);
+		vm_max = max(vm_max, vm[i]);
+	}
+
+	vector<int> count(ncoarse, 0);
+	for (int e = 0; e < nelem; ++e) {
+		double *ph = rec + elem_mat[e] * (3 + nvoi);
+		int c = -1;
+		if (stats_stride > 0) {
+			const int ex = e % (nx - 1);
+			const int ey = (e / (nx - 1)) % (ny - 1);
+			const int ez = e / ((nx - 1) * (ny - 1));
+			c = ((ez / stats_stride) * stats_ncoarse[1] + ey / stats_stride) *
+				stats_ncoarse[0] + ex / stats_stride;
+			count[c] += npe;
+		}
+
+		for (int gp = 0; gp < npe; ++gp) {
+			const int i = e * npe + gp;
+			const double *stress = &stats_ip[i * (nvoi + 1)];
+
+			ph[0] += wg;
+			for (int v = 0; v < nvoi; ++v)
+				ph[1 + v] += stress[v] * wg;
+			ph[1 + nvoi] = max(ph[1 + nvoi], vm[i]);
+			if (stress[nvoi] > 0.0)
+				ph[2 + nvoi] += wg;
+
+			const int bin = (vm_max > 0.0) ? (int) (vm[i] / vm_max * STATS_BINS) : 0;
+			hist[min(bin, STATS_BINS - 1)] += wg;
+
+			if (c >= 0)
+				coarse[c] += vm[i];
+		}
+	}
+
+	for (int p = 0; p < numMaterials; ++p) {
+		double *ph = rec + p * (3 + nvoi);
+		if (ph[0] > 0.0) {
+			for (int v = 0; v < nvoi; ++v)
+				ph[1 + v] /= ph[0];
+			ph[2 + nvoi] /= ph[0];
+		}
+	}
+	for (int c = 0; c < ncoarse; ++c)
+		coarse[c] /= count[c];
+}
+
+bool micropp_t::get_stats(const int gp_id, double *rec)
+{
+	const int rec_size = get_stats_size();
+	for (size_t r = 0; r < stats_id.size(); ++r)
+		if (stats_id[r] == gp_id) {
+			for (int i = 0; i < rec_size; ++i)
+				rec[i] = stats_rec[r * rec_size + i];
+			return true;
+		}
+	return false;
+}
+
+void micropp_t::write_stats(const int time_step)
+{
+	if (!stats_on || stats_id.empty())
+		return;
+
+	shared_ptr<vector<int>> id = make_shared<vector<int>>(stats_id);
+	shared_ptr<vector<double>> rec = make_shared<vector<double>>(stats_rec);
+	const int rec_size = get_stats_size();
+	FILE *file = stats_file;
+
+	io_submit([id, rec, rec_size, time_step, file] {
+		for (size_t r = 0; r < id->size(); ++r) {
+			const int32_t head[2] = { time_step, (*id)[r] };
+			fwrite(head, sizeof(int32_t), 2, file);
+			fwrite(&(*rec)[r * rec_size], sizeof(double), rec_size, file);
+		}
+	});
+}
@@ -0,0 +1,109 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Ae = sum_gp B^T C_gp B wg of a hexahedron without the dense B. The
+ * columns of node a of B only hold its derivatives (gx, gy, gz)
+ *
+ *       | gx  0  0 |
+ *       |  0 gy  0 |
+ *  Ba = |  0  0 gz |
+ *       | gy gx  0 |
+ *       | gz  0 gx |
+ *       |  0 gz gy |
+ *
+ * so at every Gauss point C Bb is 18 products of 3 terms and every row of
+ * Ba^T (C B) 3 more per column. The lanes of the vectors are the nodes b
+ * of the columns, the values of node a and of C are broadcast, so the
+ * rows are accumulated over the Gauss points without reductions and only
+ * transposed into Ae at the end.
+ */
+
+#include <cstring>
+
+#include "micro.hpp"
+#include "simd.hpp"
+
+void micropp_t::calc_dsh_gp()
+{
+	double bmat[6][3 * 8];
+	for (int gp = 0; gp < 8; gp++) {
+		calc_bmat_3D(gp, bmat);
+		for (int a = 0; a < 8; a++)
+			for (int d = 0; d < 3; d++)
+				dsh_gp[gp][d][a] = bmat[d][a * 3 + d];
+	}
+}
+
+void micropp_t::get_elem_mat_btcb(const double ctan[6][6][8], double (&Ae)[3 * 8 * 3 * 8])
+{
+	const double wg = (1 / 8.0) * dx * dy * dz;
+
+	// acc[a * 3 + i][j][b] = Ae[(a * 3 + i) * 24 + b * 3 + j] / wg
+	double acc[3 * 8][3][8];
+	memset(acc, 0, sizeof(acc));
+
+	for (int gp = 0; gp < 8; gp++) {
+
+		vd c[6][6];
+		for (int i = 0; i < 6; i++)
+			for (int j = 0; j < 6; j++)
+				c[i][j] = vset(ctan[i][j][gp]);
+		const double *gx = dsh_gp[gp][0];
+		const double *gy = dsh_gp[gp][1];
+		const double *gz = dsh_gp[gp][2];
+
+		for (int l = 0; l < 8; l += VW) {
+
+			// cb[m][j] = (C B)[m][b * 3 + j] of the nodes b of the lanes
+			const vd bx = vload(&gx[l]);
+			const vd by = vload(&gy[l]);
+			const vd bz = vload(&gz[l]);
+			vd cb[6][3];
+			for (int m = 0; m < 6; m++) {
+				cb[m][0] = vadd(vadd(vmul(c[m][0], bx), vmul(c[m][3], by)), vmul(c[m][4], bz));
+				cb[m][1] = vadd(vadd(vmul(c[m][1], by), vmul(c[m][3], bx)), vmul(c[m][5], bz));
+				cb[m][2] = vadd(vadd(vmul(c[m][2], bz), vmul(c[m][4], bx)), vmul(c[m][5], by));
+			}
+
+			for (int a = 0; a < 8; a++) {
+				const vd ax = vset(gx[a]);
+				const vd ay = vset(gy[a]);
+				const vd az = vset(gz[a]);
+				for (int j = 0; j < 3; j++) {
+					const vd k0 = vadd(vadd(vmul(ax, cb[0][j]), vmul(ay, cb[3][j])),
+					                   vmul(az, cb[4][j]));
+					const vd k1 = vadd(vadd(vmul(ay, cb[1][j]), vmul(ax, cb[3][j])),
+					                   vmul(az, cb[5][j]));
+					const vd k2 = vadd(vadd(vmul(az, cb[2][j]), vmul(ax, cb[4][j])),
+					                   vmul(ay, cb[5][j]));
+					vstore(&acc[a * 3 + 0][j][l], vadd(vload(&acc[a * 3 + 0][j][l]), k0));
+					vstore(&acc[a * 3 + 1][j][l], vadd(vload(&acc[a * 3 + 1][j][l]), k1));
+					vstore(&acc[a * 3 + 2][j][l], vadd(vload(&acc[a * 3 + 2][j][l]), k2));
+				}
+			}
+		}
+	}
+
+	for (int r = 0; r < 3 * 8; r++)
+		for (int b = 0; b < 8; b++)
+			for (int j = 0; j < 3; j++)
+				Ae[r * 24 + b * 3 + j] = acc[r][j][b] * wg;
+}
@@ -0,0 +1,235 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Gaussian process surrogate of the non-linear response
+ *
+ * Inputs  : x = (E, mean alpha of int_vars_n) / length
+ * Outputs : y = (S - CL : E, C - CL)
+ *
+ * with the squared exponential kernel k(x, x') = exp(-|x - x'|^2 / 2)
+ * and zero prior mean (the linear response). The Cholesky factor L of
+ * K + nugget I grows one row per training point and we keep Z = L^-1 Y,
+ * so that with v = L^-1 k(X, x)
+ *
+ *     y(x) = v^t Z        var(x) = 1 - v^t v
+ *
+ * A point is only served if the closest training point was solved from
+ * the same committed state. It then takes its converged state, as a near
+ * hit of the cache does, which continues the history of the point.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+#include "micro.hpp"
+
+#define SUR_NUGGET 1.0e-8
+
+void micropp_t::set_surrogate(const bool on, const double tol, const int max_points,
+                              const double length)
+{
+	assert(tol >= 0.0 && max_points > 0 && length > 0.0);
+	if (on && comp_on) {
+		cerr << "micropp : the surrogate can not be used with compression" << endl;
+		return;
+	}
+
+	surrogate_clear();
+	sur_on = on;
+	sur_tol = tol;
+	sur_len = length;
+	sur_max = max_points;
+
+	const int nin = nvoi + 1, nout = nvoi + nvoi * nvoi;
+	sur_x.assign(on ? max_points * nin : 0, 0.0);
+	sur_z.assign(on ? max_points * nout : 0, 0.0);
+	sur_L.assign(on ? max_points * max_points : 0, 0.0);
+}
+
+void micropp_t::surrogate_clear()
+{
+	for (auto vars : sur_vars)
+		free_int_vars(vars);
+	for (auto vars : sur_vars_n)
+		free_int_vars(vars);
+	sur_vars.clear();
+	sur_vars_n.clear();
+	sur_n = 0;
+	sur_served = sur_solved = 0;
+}
+
+void micropp_t::get_surrogate_stats(int *served, int *solved)
+{
+	*served = sur_served;
+	*solved = sur_solved;
+}
+
+double micropp_t::get_state_summary(const double *int_vars)
+{
+	if (int_vars == NULL)
+		return 0.0;
+
+	double alpha = 0.0;
+	for (int e = 0; e < nelem; ++e)
+		for (int gp = 0; gp < npe; ++gp)
+			alpha += int_vars[intvar_ix(e, gp, 6)];
+	return alpha / (nelem * npe);
+}
+
+void micropp_t::surrogate_input(const gp_t &gp, double *x)
+{
+	for (int i = 0; i < nvoi; ++i)
+		x[i] = gp.macro_strain[i] / sur_len;
+	x[nvoi] = get_state_summary(gp.int_vars_n) / sur_len;
+}
+
+double micropp_t::surrogate_solve(const double *x, double *v)
+{
+	// v = L^-1 k(X, x), returns the predictive variance
+	const int nin = nvoi + 1;
+	double var = 1.0 + SUR_NUGGET;
+	for (int i = 0; i < sur_n; ++i) {
+		double dist = 0.0;
+		for (int j = 0; j < nin; ++j)
+			dist += (x[j] - sur_x[i * nin + j]) * (x[j] - sur_x[i * nin + j]);
+		v[i] = exp(-0.5 * dist);
+		for (int j = 0; j < i; ++j)
+			v[i] -= sur_L[i * sur_max + j] * v[j];
+		v[i] /= sur_L[i * sur_max + i];
+		var -= v[i] * v[i];
+	}
+	return var;
+}
+
+bool micropp_t::surrogate_lookup(gp_t &gp)
+{
+	if (sur_n == 0)
+		return false;
+
+	const int nout = nvoi + nvoi * nvoi;
+	double x[7];
+	vector<double> v(sur_n);
+	surrogate_input(gp, x);
+
+	if (surrogate_solve(x, v.data()) > sur_tol)
+		return false;
+
+	// Closest training point : largest k(x_i, x) = (L v)_i
+	int near = 0;
+	double k_max = -1.0;
+	for (int i = 0; i < sur_n; ++i) {
+		double k = 0.0;
+		for (int j = 0; j <= i; ++j)
+			k += sur_L[i * sur_max + j] * v[j];
+		if (k > k_max) {
+			k_max = k;
+			near = i;
+		}
+	}
+
+	// The state of another history is not adopted
+	const bool zero = (gp.int_vars_n == NULL || get_fingerprint(gp.int_vars_n) == 0);
+	if ((sur_vars_n[near] == NULL) ? !zero :
+	    (zero || memcmp(sur_vars_n[near], gp.int_vars_n, num_int_vars * sizeof(double)) != 0))
+		return false;
+
+	calc_lin_stress(1, gp.macro_strain, gp.macro_stress);
+	for (int o = 0; o < nout; ++o) {
+		double y = 0.0;
+		for (int i = 0; i < sur_n; ++i)
+			y += v[i] * sur_z[i * nout + o];
+		if (o < nvoi)
+			gp.macro_stress[o] += y;
+		else
+			gp.macro_ctan[o - nvoi] = ctan_lin[o - nvoi] + y;
+	}
+
+	if (sur_vars[near] != NULL) {
+		if (gp.int_vars_n == NULL) {
+			gp.int_vars_k = alloc_int_vars(false);
+			gp.int_vars_n = alloc_int_vars(true);
+		} else if (gp.int_vars_k == NULL) {
+			gp.int_vars_k = alloc_int_vars(false);
+		} else {
+			unshare_int_vars_k(gp);
+		}
+		memcpy(gp.int_vars_k, sur_vars[near], num_int_vars * sizeof(double));
+		gp.version = vars_version;
+	} else {
+		reset_int_vars_k(gp);
+	}
+
+	for (int i = 0; i < (1 + nvoi); ++i) {
+		gp.nr_its[i] = 0;
+		gp.nr_err[i] = 0.0;
+	}
+	return true;
+}
+
+void micropp_t::surrogate_insert(const gp_t &gp)
+{
+	if (sur_n == sur_max)
+		return;
+
+	const int nin = nvoi + 1, nout = nvoi + nvoi * nvoi;
+	double x[7], y[42], lin_stress[6];
+	vector<double> l(sur_n + 1);
+	surrogate_input(gp, x);
+
+	double d2 = surrogate_solve(x, l.data());
+	if (d2 <= 1.0e-3 * SUR_NUGGET)
+		return;			// already represented
+	const double d = sqrt(d2);
+
+	calc_lin_stress(1, gp.macro_strain, lin_stress);
+	for (int o = 0; o < nvoi; ++o)
+		y[o] = gp.macro_stress[o] - lin_stress[o];
+	for (int o = 0; o < nvoi * nvoi; ++o)
+		y[nvoi + o] = gp.macro_ctan[o] - ctan_lin[o];
+
+	const int n = sur_n;
+	for (int j = 0; j < nin; ++j)
+		sur_x[n * nin + j] = x[j];
+	for (int j = 0; j < n; ++j)
+		sur_L[n * sur_max + j] = l[j];
+	sur_L[n * sur_max + n] = d;
+
+	for (int o = 0; o < nout; ++o) {
+		double z = y[o];
+		for (int i = 0; i < n; ++i)
+			z -= l[i] * sur_z[i * nout + o];
+		sur_z[n * nout + o] = z / d;
+	}
+
+	double *vars = NULL, *vars_n = NULL;
+	if (gp.int_vars_n != NULL) {
+		vars = alloc_int_vars(false);
+		memcpy(vars, gp.int_vars_k, num_int_vars * sizeof(double));
+		if (get_fingerprint(gp.int_vars_n) != 0) {
+			vars_n = alloc_int_vars(false);
+			memcpy(vars_n, gp.int_vars_n, num_int_vars * sizeof(double));
+		}
+	}
+	sur_vars.push_back(vars);
+	sur_vars_n.push_back(vars_n);
+	sur_n++;
+}
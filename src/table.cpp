@@ -0,0 +1,328 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "micro.hpp"
+
+// Relative distance of the strain to the ray of a table path
+#define TABLE_RAY_TOL 1.0e-6
+
+void micropp_t::write_table(const char *fname, const int *npts,
+                            const double *eps_min, const double *eps_max)
+{
+	table_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TABLE_MAGIC, 8);
+	header.version = TABLE_VERSION;
+	header.nvoi = nvoi;
+	header.size[0] = nx;
+	header.size[1] = ny;
+	header.size[2] = nz;
+	header.micro_type = micro_type;
+	header.nnodes = 1;
+	for (int d = 0; d < nvoi; ++d) {
+		assert(npts[d] >= 1);
+		header.npts[d] = npts[d];
+		header.eps_min[d] = eps_min[d];
+		header.eps_max[d] = (npts[d] > 1) ? eps_max[d] : eps_min[d];
+		header.nnodes *= npts[d];
+	}
+
+	FILE *file = fopen(fname, "wb");
+	if (file == NULL) {
+		cerr << "micropp : can not open " << fname << endl;
+		return;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+
+	// The sweep must not feed nor use the cache
+	bool cache_on_0 = cache_on;
+	cache_on = false;
+
+	const int rec = nvoi + nvoi * nvoi + 1;
+	vector<double> record(rec);
+	double strain[6], stress[6];
+
+	gp_t gp;
+	gp.id = -1;
+	gp.macro_strain = strain;
+	gp.macro_stress = stress;
+
+	for (uint64_t n = 0; n < header.nnodes; ++n) {
+		uint64_t rest = n;
+		for (int d = 0; d < nvoi; ++d) {
+			int i = rest % npts[d];
+			rest /= npts[d];
+			strain[d] = (npts[d] > 1) ?
+				eps_min[d] + i * (eps_max[d] - eps_min[d]) / (npts[d] - 1) :
+				eps_min[d];
+		}
+
+		gp.int_vars_n = NULL;
+		gp.int_vars_k = NULL;
+		gp.int_vars_c = NULL;
+		gp.rom_vars_n = NULL;
+		gp.rom_vars_k = NULL;
+		gp.table_eps_n = NULL;
+		gp.table_eps_k = NULL;
+		gp.version = -1;
+		gp.macro_ctan = &record[nvoi];
+		solve_gp(gp);
+		record[rec - 1] = (gp.int_vars_k != NULL) ? 1.0 : 0.0;
+		free_int_vars(gp.int_vars_n);
+		free_int_vars(gp.int_vars_k);
+
+		for (int i = 0; i < nvoi; ++i)
+			record[i] = stress[i];
+		fwrite(record.data(), sizeof(double), rec, file);
+	}
+
+	cache_on = cache_on_0;
+	fclose(file);
+}
+
+bool micropp_t::load_table(const char *fname)
+{
+	unload_table();
+
+	int fd = open(fname, O_RDONLY);
+	if (fd < 0) {
+		cerr << "micropp : can not open " << fname << endl;
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(table_header_t)) {
+		cerr << "micropp : " << fname << " is not a table file" << endl;
+		close(fd);
+		return false;
+	}
+
+	// Only the header is touched here, the data is paged in on demand
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		cerr << "micropp : can not map " << fname << endl;
+		return false;
+	}
+
+	const table_header_t *header = (const table_header_t *) map;
+	const size_t rec = nvoi + nvoi * nvoi + 1;
+	if (memcmp(header->magic, TABLE_MAGIC, 8) != 0 ||
+	    header->version != TABLE_VERSION || header->nvoi != nvoi ||
+	    header->size[0] != nx || header->size[1] != ny || header->size[2] != nz ||
+	    header->micro_type != micro_type ||
+	    (uint64_t) st.st_size != sizeof(table_header_t) + header->nnodes * rec * sizeof(double)) {
+		cerr << "micropp : " << fname << " does not match this micro-structure" << endl;
+		munmap(map, st.st_size);
+		return false;
+	}
+
+	table_on = true;
+	table_bytes = st.st_size;
+	table_header = header;
+	table_data = (const double *) (header + 1);
+	table_hits = 0;
+	return true;
+}
+
+void micropp_t::unload_table()
+{
+	if (table_header != NULL)
+		munmap((void *) table_header, table_bytes);
+	table_on = false;
+	table_bytes = 0;
+	table_header = NULL;
+	table_data = NULL;
+}
+
+long micropp_t::get_table_hits()
+{
+	return table_hits;
+}
+
+static bool table_on_ray(const int nvoi, const double *eps_n, const double *eps)
+{
+	// eps = s eps_n + r with s >= 1 and r ~ 0 : the loading goes on along
+	// the ray, so the table solve from the virgin state still holds
+	double nn = 0.0, ne = 0.0, ee = 0.0;
+	for (int i = 0; i < nvoi; ++i) {
+		nn += eps_n[i] * eps_n[i];
+		ne += eps_n[i] * eps[i];
+		ee += eps[i] * eps[i];
+	}
+	if (nn == 0.0)
+		return true;
+	return (ne >= (1.0 - TABLE_RAY_TOL) * nn) &&
+		(ee - ne * ne / nn <= TABLE_RAY_TOL * TABLE_RAY_TOL * ee);
+}
+
+bool micropp_t::table_lookup(gp_t &gp)
+{
+	// The table represents the points with no history and those on a
+	// table path that is still monotonic
+	if (gp.int_vars_n != NULL || gp.int_vars_c != NULL || gp.rom_vars_n != NULL)
+		return false;
+	if (gp.table_eps_n != NULL && !table_on_ray(nvoi, gp.table_eps_n, gp.macro_strain))
+		return false;
+
+	const table_header_t *h = table_header;
+	int na = 0;
+	uint64_t base = 0, stride = 1, strides[6];
+	double t[6];
+
+	for (int d = 0; d < nvoi; ++d) {
+		const double eps = gp.macro_strain[d];
+		if (h->npts[d] == 1) {
+			if (eps != h->eps_min[d])
+				return false;
+		} else {
+			const double step = (h->eps_max[d] - h->eps_min[d]) / (h->npts[d] - 1);
+			const double x = (eps - h->eps_min[d]) / step;
+			if (!(x >= 0.0 && x <= h->npts[d] - 1))
+				return false;
+			int i0 = (int) floor(x);
+			if (i0 > h->npts[d] - 2)
+				i0 = h->npts[d] - 2;
+			base += i0 * stride;
+			strides[na] = stride;
+			t[na++] = x - i0;
+		}
+		stride *= h->npts[d];
+	}
+
+	// The virgin elastic domain is convex in the macro strain, so a cell
+	// with elastic nodes is elastic inside. A point in a cell with a
+	// yielded node goes on a table path.
+	const int rec = nvoi + nvoi * nvoi + 1;
+	bool yielded = false;
+	double res[6 + 36];
+	for (int i = 0; i < rec - 1; ++i)
+		res[i] = 0.0;
+
+	for (int c = 0; c < (1 << na); ++c) {
+		double w = 1.0;
+		uint64_t node = base;
+		for (int a = 0; a < na; ++a) {
+			if (c & (1 << a)) {
+				w *= t[a];
+				node += strides[a];
+			} else {
+				w *= 1.0 - t[a];
+			}
+		}
+		if (w == 0.0)
+			continue;
+		const double *val = &table_data[node * rec];
+		yielded = yielded || (val[rec - 1] != 0.0);
+		for (int i = 0; i < rec - 1; ++i)
+			res[i] += w * val[i];
+	}
+
+	for (int i = 0; i < nvoi; ++i)
+		gp.macro_stress[i] = res[i];
+	for (int i = 0; i < nvoi * nvoi; ++i)
+		gp.macro_ctan[i] = res[nvoi + i];
+	for (int i = 0; i < (1 + nvoi); ++i) {
+		gp.nr_its[i] = 0;
+		gp.nr_err[i] = 0.0;
+	}
+
+	// The trial state of a table path is the strain
+	if (yielded || gp.table_eps_n != NULL) {
+		if (gp.table_eps_n == NULL) {
+			gp.table_eps_n = (double *) calloc(nvoi, sizeof(double));
+			gp.table_eps_k = (double *) malloc(nvoi * sizeof(double));
+		}
+		memcpy(gp.table_eps_k, gp.macro_strain, nvoi * sizeof(double));
+		gp.version = vars_version;
+	}
+
+	table_hits++;
+	return true;
+}
+
+void micropp_t::table_restore(gp_t &gp)
+{
+	// The committed state of a table path is the one of a solve from
+	// the virgin state to table_eps_n, it becomes the int_vars of the point
+	bool zero = true;
+	for (int i = 0; i < nvoi; ++i)
+		zero = zero && (gp.table_eps_n[i] == 0.0);
+
+	if (!zero) {
+		double strain[6], stress[6], ctan[36];
+		memcpy(strain, gp.table_eps_n, nvoi * sizeof(double));
+
+		bool cache_on_0 = cache_on, pod_snap_on_0 = pod_snap_on;
+		cache_on = false;
+		pod_snap_on = false;
+
+		gp_t gp_v;
+		gp_v.id = -1;
+		gp_v.int_vars_n = NULL;
+		gp_v.int_vars_k = NULL;
+		gp_v.int_vars_c = NULL;
+		gp_v.rom_vars_n = NULL;
+		gp_v.rom_vars_k = NULL;
+		gp_v.table_eps_n = NULL;
+		gp_v.table_eps_k = NULL;
+		gp_v.version = -1;
+		gp_v.macro_strain = strain;
+		gp_v.macro_stress = stress;
+		gp_v.macro_ctan = ctan;
+		solve_gp(gp_v);
+
+		cache_on = cache_on_0;
+		pod_snap_on = pod_snap_on_0;
+
+		// Committed as update_vars does, int_vars_k equal to it
+		if (gp_v.int_vars_k != NULL) {
+			if (comp_on) {
+				gp.int_vars_c_size = compress_vars(gp_v.int_vars_k, &gp.int_vars_c);
+				free_int_vars(gp_v.int_vars_k);
+			} else if (dedup_on) {
+				free_int_vars(gp_v.int_vars_n);
+				gp.int_vars_n = gp.int_vars_k = dedup_commit(gp_v.int_vars_k);
+			} else {
+				gp.int_vars_n = gp_v.int_vars_k;
+				gp.int_vars_k = gp_v.int_vars_n;
+				memcpy(gp.int_vars_k, gp.int_vars_n, num_int_vars * sizeof(double));
+			}
+			if (cache_on)
+				gp.fingerprint = get_fingerprint(gp.int_vars_n);
+			if (spill_on)
+				spill_touch(gp);
+		}
+	}
+
+	free(gp.table_eps_n);
+	free(gp.table_eps_k);
+	gp.table_eps_n = gp.table_eps_k = NULL;
+}
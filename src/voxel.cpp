@@ -0,0 +1,125 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Voxel micro-structures (CT images). The raw file holds one uint8 phase
+ * per voxel, x fastest, after offset bytes of header. It is mapped read
+ * only and the element (ex, ey, ez) takes the voxel
+ *
+ *     (ex * nvox[0] / nex, ey * nvox[1] / ney, ez * nvox[2] / nez)
+ *
+ * The index tables are computed once, so the pass over the slabs of
+ * elements is only loads and stores.
+ */
+
+#include <cstring>
+#include <cassert>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "micro.hpp"
+
+bool micropp_t::load_voxels(const char *fname, const int nvox[3], const size_t offset)
+{
+	const int nex[3] = { nx - 1, ny - 1, (dim == 3) ? nz - 1 : 1 };
+	const int nv[3] = { nvox[0], nvox[1], (dim == 3) ? nvox[2] : 1 };
+	assert(nv[0] > 0 && nv[1] > 0 && nv[2] > 0);
+
+	int fd = open(fname, O_RDONLY);
+	if (fd < 0) {
+		cerr << "micropp : can not open " << fname << endl;
+		return false;
+	}
+
+	const size_t bytes = offset + (size_t) nv[0] * nv[1] * nv[2];
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < bytes) {
+		cerr << "micropp : " << fname << " is smaller than the image" << endl;
+		close(fd);
+		return false;
+	}
+
+	void *map = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		cerr << "micropp : can not map " << fname << endl;
+		return false;
+	}
+
+	// One voxel per element is read in order, otherwise rows are skipped
+	const bool same = (nv[0] == nex[0] && nv[1] == nex[1] && nv[2] == nex[2]);
+	madvise(map, bytes, same ? MADV_SEQUENTIAL : MADV_RANDOM);
+	const uint8_t *img = (const uint8_t *) map + offset;
+
+	vector<int> idx[3];
+	for (int d = 0; d < 3; ++d) {
+		idx[d].resize(nex[d]);
+		for (int e = 0; e < nex[d]; ++e)
+			idx[d][e] = (int) ((long) e * nv[d] / nex[d]);
+	}
+
+	const int nthreads = max(1, min((int) std::thread::hardware_concurrency(), nex[2]));
+	vector<int> thr_max(nthreads, 0);
+	vector<std::thread> threads;
+	for (int t = 0; t < nthreads; ++t)
+		threads.push_back(std::thread([&, t] {
+			const int *ix = idx[0].data();
+			int phase_max = 0;
+			for (int ez = t; ez < nex[2]; ez += nthreads) {
+				const size_t slab = (size_t) idx[2][ez] * nv[1];
+				for (int ey = 0; ey < nex[1]; ++ey) {
+					const uint8_t *row = img + (slab + idx[1][ey]) * nv[0];
+					int *et = elem_type + ((size_t) ez * nex[1] + ey) * nex[0];
+					for (int ex = 0; ex < nex[0]; ++ex) {
+						et[ex] = row[ix[ex]];
+						phase_max = max(phase_max, et[ex]);
+					}
+				}
+			}
+			thr_max[t] = phase_max;
+		}));
+	for (auto &thr : threads)
+		thr.join();
+	munmap(map, bytes);
+
+	int phase_max = 0;
+	for (int t = 0; t < nthreads; ++t)
+		phase_max = max(phase_max, thr_max[t]);
+
+	// An image with unknown phases leaves the micro_type geometry
+	const bool ok = (phase_max < numMaterials);
+	if (!ok) {
+		cerr << "micropp : " << fname << " has phase " << phase_max
+			<< " but there are " << numMaterials << " materials" << endl;
+		calc_elem_types();
+	} else {
+		calc_elem_mats();
+	}
+
+	// From the zero displacement of the constructor, the first solves do
+	// not depend on the geometry that was replaced
+	memset(u, 0, nn * dim * sizeof(double));
+	calc_ctan_lin();
+	return ok;
+}
@@ -0,0 +1,206 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * VTU with the arrays in binary appended data. The arrays are built in
+ * memory and the file goes out in a few fwrite calls. Every array is
+ * preceded by its UInt64 size (VTU_RAW) or, with VTU_ZLIB, compressed in
+ * blocks of VTU_BLOCK bytes preceded by the UInt64 header
+ *
+ *     nblocks, VTU_BLOCK, last partial block size, compressed sizes
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <sstream>
+#include <string>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "micro.hpp"
+
+#define VTU_BLOCK (1 << 16)
+
+bool micropp_t::set_vtu_format(const int format)
+{
+	assert(format == VTU_ASCII || format == VTU_RAW || format == VTU_ZLIB ||
+	       format == VTU_XDMF);
+#ifndef HAVE_ZLIB
+	if (format == VTU_ZLIB) {
+		cerr << "micropp : built without zlib, the VTU are not compressed" << endl;
+		vtu_format = VTU_RAW;
+		return false;
+	}
+#endif
+	vtu_format = format;
+	return true;
+}
+
+static uint64_t vtu_append(vector<unsigned char> &data, const void *array,
+                           const uint64_t bytes, const bool zlib)
+{
+	// Returns the offset of the array in the appended data
+	const uint64_t offset = data.size();
+	const unsigned char *src = (const unsigned char *) array;
+
+	if (!zlib) {
+		data.resize(offset + sizeof(uint64_t) + bytes);
+		memcpy(&data[offset], &bytes, sizeof(uint64_t));
+		memcpy(&data[offset + sizeof(uint64_t)], src, bytes);
+		return offset;
+	}
+
+#ifdef HAVE_ZLIB
+	const uint64_t nblocks = (bytes + VTU_BLOCK - 1) / VTU_BLOCK;
+	vector<uint64_t> header(3 + nblocks);
+	header[0] = nblocks;
+	header[1] = VTU_BLOCK;
+	header[2] = bytes % VTU_BLOCK;
+	data.resize(offset + header.size() * sizeof(uint64_t));
+
+	for (uint64_t b = 0; b < nblocks; ++b) {
+		const uLong n = (b < nblocks - 1 || header[2] == 0) ? VTU_BLOCK : header[2];
+		uLongf size = compressBound(n);
+		const size_t pos = data.size();
+		data.resize(pos + size);
+		compress2(&data[pos], &size, src + b * VTU_BLOCK, n, Z_BEST_SPEED);
+		data.resize(pos + size);
+		header[3 + b] = size;
+	}
+	memcpy(&data[offset], header.data(), header.size() * sizeof(uint64_t));
+#endif
+	return offset;
+}
+
+void micropp_t::get_grid(vector<double> &coor, vector<int32_t> &conn)
+{
+	// Node coordinates (nn * 3) and element connectivity (nelem * npe)
+	coor.resize(nn * 3);
+	for (int k = 0; k < nz; ++k)
+		for (int j = 0; j < ny; ++j)
+			for (int i = 0; i < nx; ++i) {
+				const int n = (k * ny + j) * nx + i;
+				coor[n * 3 + 0] = i * dx;
+				coor[n * 3 + 1] = j * dy;
+				coor[n * 3 + 2] = (dim == 3) ? k * dz : 0.0;
+			}
+
+	conn.resize(nelem * npe);
+	for (int e = 0; e < nelem; ++e) {
+		const int ex = e % (nx - 1);
+		const int ey = (e / (nx - 1)) % (ny - 1);
+		const int ez = e / ((nx - 1) * (ny - 1));
+		const int n0 = ez * (nx * ny) + ey * nx + ex;
+		int32_t *c = &conn[e * npe];
+		c[0] = n0;
+		c[1] = n0 + 1;
+		c[2] = n0 + nx + 1;
+		c[3] = n0 + nx;
+		if (dim == 3)
+			for (int i = 0; i < 4; ++i)
+				c[4 + i] = c[i] + nx * ny;
+	}
+}
+
+void micropp_t::write_vtu_appended(const vtu_snapshot_t &snap)
+{
+	const bool zlib = (snap.format == VTU_ZLIB);
+	vector<unsigned char> data;
+	uint64_t off[11];
+
+	vector<double> coor_d;
+	vector<int32_t> conn, offsets(nelem);
+	get_grid(coor_d, conn);
+	vector<float> coor(coor_d.begin(), coor_d.end());
+	off[0] = vtu_append(data, coor.data(), coor.size() * sizeof(float), zlib);
+
+	vector<uint8_t> types(nelem, (dim == 2) ? 9 : 12);
+	for (int e = 0; e < nelem; ++e)
+		offsets[e] = (e + 1) * npe;
+	off[1] = vtu_append(data, conn.data(), conn.size() * sizeof(int32_t), zlib);
+	off[2] = vtu_append(data, offsets.data(), offsets.size() * sizeof(int32_t), zlib);
+	off[3] = vtu_append(data, types.data(), types.size(), zlib);
+
+	vector<double> field(nn * 3, 0.0);
+	for (int n = 0; n < nn; ++n)
+		for (int d = 0; d < dim; ++d)
+			field[n * 3 + d] = snap.u[n * dim + d];
+	off[4] = vtu_append(data, field.data(), field.size() * sizeof(double), zlib);
+	for (int n = 0; n < nn; ++n)
+		for (int d = 0; d < dim; ++d)
+			field[n * 3 + d] = snap.b[n * dim + d];
+	off[5] = vtu_append(data, field.data(), field.size() * sizeof(double), zlib);
+
+	off[6] = vtu_append(data, snap.elem_strain.data(), nelem * nvoi * sizeof(double), zlib);
+	off[7] = vtu_append(data, snap.elem_stress.data(), nelem * nvoi * sizeof(double), zlib);
+	off[8] = vtu_append(data, snap.elem_type.data(), nelem * sizeof(int32_t), zlib);
+	off[9] = vtu_append(data, snap.plasticity.data(), nelem * sizeof(double), zlib);
+	off[10] = vtu_append(data, snap.hardening.data(), nelem * sizeof(double), zlib);
+
+	const uint16_t one = 1;
+	const bool little = *((const unsigned char *) &one) == 1;
+
+	std::stringstream head;
+	head << "<?xml version=\"1.0\"?>\n"
+	     << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\""
+	     << (little ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\""
+	     << (zlib ? " compressor=\"vtkZLibDataCompressor\"" : "") << ">\n"
+	     << "<UnstructuredGrid>\n"
+	     << "<Piece NumberOfPoints=\"" << nn << "\" NumberOfCells=\"" << nelem << "\">\n"
+	     << "<Points>\n"
+	     << "<DataArray type=\"Float32\" Name=\"Position\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << off[0] << "\"/>\n"
+	     << "</Points>\n"
+	     << "<Cells>\n"
+	     << "<DataArray type=\"Int32\" Name=\"connectivity\" format=\"appended\" offset=\"" << off[1] << "\"/>\n"
+	     << "<DataArray type=\"Int32\" Name=\"offsets\" format=\"appended\" offset=\"" << off[2] << "\"/>\n"
+	     << "<DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"" << off[3] << "\"/>\n"
+	     << "</Cells>\n"
+	     << "<PointData Vectors=\"displ\">\n"
+	     << "<DataArray type=\"Float64\" Name=\"displ\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << off[4] << "\"/>\n"
+	     << "<DataArray type=\"Float64\" Name=\"b\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << off[5] << "\"/>\n"
+	     << "</PointData>\n"
+	     << "<CellData>\n"
+	     << "<DataArray type=\"Float64\" Name=\"strain\" NumberOfComponents=\"" << nvoi << "\" format=\"appended\" offset=\"" << off[6] << "\"/>\n"
+	     << "<DataArray type=\"Float64\" Name=\"stress\" NumberOfComponents=\"" << nvoi << "\" format=\"appended\" offset=\"" << off[7] << "\"/>\n"
+	     << "<DataArray type=\"Int32\" Name=\"elem_type\" format=\"appended\" offset=\"" << off[8] << "\"/>\n"
+	     << "<DataArray type=\"Float64\" Name=\"plasticity\" format=\"appended\" offset=\"" << off[9] << "\"/>\n"
+	     << "<DataArray type=\"Float64\" Name=\"hardening\" format=\"appended\" offset=\"" << off[10] << "\"/>\n"
+	     << "</CellData>\n"
+	     << "</Piece>\n"
+	     << "</UnstructuredGrid>\n"
+	     << "<AppendedData encoding=\"raw\">\n_";
+	const std::string head_s = head.str();
+	const char tail[] = "\n</AppendedData>\n</VTKFile>\n";
+
+	std::stringstream fname;
+	fname << "micropp_" << snap.gp_id << "_" << snap.time_step << ".vtu";
+	FILE *file = fopen(fname.str().c_str(), "wb");
+	if (file == NULL) {
+		cerr << "micropp : can not open " << fname.str() << endl;
+		return;
+	}
+	fwrite(head_s.data(), 1, head_s.size(), file);
+	fwrite(data.data(), 1, data.size(), file);
+	fwrite(tail, 1, sizeof(tail) - 1, file);
+	fclose(file);
+}
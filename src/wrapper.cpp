@@ -38,6 +38,61 @@ extern "C" {
 		micro->output (*tstep, *gp_id);
 	}
 
+	void micropp_output_collective_(int *tstep, int *ngp, int *gp_id, int *nthreads)
+	{
+		micro->output_collective(*tstep, *ngp, gp_id, *nthreads);
+	}
+
+	void micropp_set_watch_(int *ngp, int *gp_id)
+	{
+		micro->set_watch(*ngp, gp_id);
+	}
+
+	void micropp_set_vtu_format_(int *format, int *ok)
+	{
+		*ok = micro->set_vtu_format(*format);
+	}
+
+	void micropp_set_async_output_(int *on, int *max_jobs)
+	{
+		micro->set_async_output(*on != 0, *max_jobs);
+	}
+
+	void micropp_flush_output_(void)
+	{
+		micro->io_flush();
+	}
+
+	void micropp_open_log_(char *prefix, int *vars_every, int *ok)
+	{
+		*ok = micro->open_log(prefix, *vars_every);
+	}
+
+	void micropp_write_log_(void)
+	{
+		micro->write_log();
+	}
+
+	void micropp_close_log_(void)
+	{
+		micro->close_log();
+	}
+
+	void micropp_open_stats_(char *fname, int *stride, int *ok)
+	{
+		*ok = micro->open_stats(fname, *stride);
+	}
+
+	void micropp_write_stats_(int *time_step)
+	{
+		micro->write_stats(*time_step);
+	}
+
+	void micropp_close_stats_(void)
+	{
+		micro->close_stats();
+	}
+
 	void micropp_get_non_linear_flag_(int *gp_id, int *non_linear)
 	{
 		micro->get_nl_flag (*gp_id, non_linear);
@@ -48,6 +103,17 @@ extern "C" {
 		micro->set_macro_strain(*gp_id, macro_strain);
 	}
 
+	void micropp_set_macro_strains_(int *ngp, int *gp_id, double *macro_strain)
+	{
+		micro->set_macro_strains(*ngp, gp_id, macro_strain);
+	}
+
+	void micropp_set_gp_buffers_(int *ngp, int *gp_id, double *macro_strain,
+	                             double *macro_stress, double *macro_ctan)
+	{
+		micro->set_gp_buffers(*ngp, gp_id, macro_strain, macro_stress, macro_ctan);
+	}
+
 	void micropp_homogenize_(void)
 	{
 		micro->homogenize();
@@ -63,11 +129,141 @@ extern "C" {
 		micro->get_macro_ctan(*gp_id, macro_ctan);
 	}
 
+	void micropp_get_macro_stresses_(int *ngp, int *gp_id, double *macro_stress)
+	{
+		micro->get_macro_stresses(*ngp, gp_id, macro_stress);
+	}
+
+	void micropp_get_macro_ctans_(int *ngp, int *gp_id, double *macro_ctan)
+	{
+		micro->get_macro_ctans(*ngp, gp_id, macro_ctan);
+	}
+
+	void micropp_set_cache_(int *on, double *tol, int *max_entries)
+	{
+		micro->set_cache(*on != 0, *tol, *max_entries);
+	}
+
+	void micropp_get_cache_stats_(long *hits, long *near_hits, long *misses)
+	{
+		micro->get_cache_stats(hits, near_hits, misses);
+	}
+
+	// fname must be null terminated : trim(fname)//char(0)
+	void micropp_write_table_(char *fname, int *npts, double *eps_min, double *eps_max)
+	{
+		micro->write_table(fname, npts, eps_min, eps_max);
+	}
+
+	void micropp_load_table_(char *fname, int *ok)
+	{
+		*ok = micro->load_table(fname);
+	}
+
+	// fname must be null terminated : trim(fname)//char(0)
+	void micropp_write_checkpoint_(char *fname)
+	{
+		micro->write_checkpoint(fname);
+	}
+
+	void micropp_load_checkpoint_(char *fname, int *ok)
+	{
+		*ok = micro->load_checkpoint(fname);
+	}
+
+	// fname must be null terminated : trim(fname)//char(0)
+	void micropp_load_voxels_(char *fname, int *nvox, long *offset, int *ok)
+	{
+		*ok = micro->load_voxels(fname, nvox, *offset);
+	}
+
+	void micropp_calc_clusters_(int *nclus)
+	{
+		micro->calc_clusters(*nclus);
+	}
+
+	void micropp_set_rom_(int *on)
+	{
+		micro->set_rom(*on != 0);
+	}
+
+	void micropp_set_pod_snapshots_(int *on)
+	{
+		micro->set_pod_snapshots(*on != 0);
+	}
+
+	void micropp_calc_pod_(int *nmodes, double *tol)
+	{
+		micro->calc_pod(*nmodes, *tol);
+	}
+
+	void micropp_set_pod_(int *on)
+	{
+		micro->set_pod(*on != 0);
+	}
+
+	void micropp_get_rom_error_(double *macro_strain, double *err)
+	{
+		*err = micro->get_rom_error(macro_strain);
+	}
+
+	void micropp_set_surrogate_(int *on, double *tol, int *max_points, double *length)
+	{
+		micro->set_surrogate(*on != 0, *tol, *max_points, *length);
+	}
+
+	void micropp_get_surrogate_stats_(int *served, int *solved)
+	{
+		micro->get_surrogate_stats(served, solved);
+	}
+
+	void micropp_get_arena_stats_(long *reserved, long *in_use)
+	{
+		size_t reserved_b, in_use_b;
+		micro->get_arena_stats(&reserved_b, &in_use_b);
+		*reserved = reserved_b;
+		*in_use = in_use_b;
+	}
+
+	// dir must be null terminated : trim(dir)//char(0)
+	void micropp_set_spill_(char *dir, long *ram_budget, int *ok)
+	{
+		*ok = micro->set_spill(dir, *ram_budget);
+	}
+
+	void micropp_set_compression_(int *on, double *tol)
+	{
+		micro->set_compression(*on != 0, *tol);
+	}
+
+	void micropp_get_compression_stats_(long *raw, long *compressed)
+	{
+		size_t raw_b, compressed_b;
+		micro->get_compression_stats(&raw_b, &compressed_b);
+		*raw = raw_b;
+		*compressed = compressed_b;
+	}
+
+	void micropp_set_dedup_(int *on)
+	{
+		micro->set_dedup(*on != 0);
+	}
+
+	void micropp_get_dedup_stats_(long *blocks_logical, long *blocks_physical)
+	{
+		micro->get_dedup_stats(blocks_logical, blocks_physical);
+	}
+
 	void micropp_update_internal_variables_(void)
 	{
 		micro->update_vars ();
 	}
 
+	void micropp_rollback_internal_variables_(void)
+	{
+		micro->rollback_vars ();
+	}
+
 	void micropp_write_convergence_file_(void)
 	{
 		micro->write_info_files ();
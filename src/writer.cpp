@@ -0,0 +1,113 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Background writer. The compute thread takes snapshots of the data
+ * and pushes the jobs that format and write them. The writer runs them
+ * in order, so the files are the same as with the synchronous output.
+ */
+
+#include <cassert>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "micro.hpp"
+
+struct writer_t {
+	int max_jobs;
+	bool stop, busy;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::thread thr;
+};
+
+static void writer_loop(writer_t *w)
+{
+	std::unique_lock<std::mutex> lock(w->mtx);
+	while (true) {
+		w->cv.wait(lock, [w] { return w->stop || !w->jobs.empty(); });
+		if (w->jobs.empty())
+			return;
+
+		std::function<void()> job = std::move(w->jobs.front());
+		w->jobs.pop_front();
+		w->busy = true;
+		lock.unlock();
+		w->cv.notify_all();
+
+		job();
+
+		lock.lock();
+		w->busy = false;
+		w->cv.notify_all();
+	}
+}
+
+void micropp_t::set_async_output(const bool on, const int max_jobs)
+{
+	assert(max_jobs > 0);
+
+	if (writer != NULL) {
+		// The queued jobs are done before the writer stops
+		{
+			std::lock_guard<std::mutex> lock(writer->mtx);
+			writer->stop = true;
+		}
+		writer->cv.notify_all();
+		writer->thr.join();
+		delete writer;
+		writer = NULL;
+	}
+
+	if (on) {
+		writer = new writer_t;
+		writer->max_jobs = max_jobs;
+		writer->stop = false;
+		writer->busy = false;
+		writer->thr = std::thread(writer_loop, writer);
+	}
+}
+
+void micropp_t::io_submit(function<void()> job)
+{
+	if (writer == NULL) {
+		job();
+		return;
+	}
+
+	// Back-pressure : waits for room in the queue
+	std::unique_lock<std::mutex> lock(writer->mtx);
+	writer->cv.wait(lock, [this] { return (int) writer->jobs.size() < writer->max_jobs; });
+	writer->jobs.push_back(std::move(job));
+	lock.unlock();
+	writer->cv.notify_all();
+}
+
+void micropp_t::io_flush()
+{
+	if (writer == NULL)
+		return;
+
+	std::unique_lock<std::mutex> lock(writer->mtx);
+	writer->cv.wait(lock, [this] { return writer->jobs.empty() && !writer->busy; });
+}
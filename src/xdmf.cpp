@@ -0,0 +1,206 @@
+/*
+ *  This source code is part of MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * XDMF time series of a point. The grid does not change, so
+ * micropp_<gp_id>_geom.bin (native byte order) is written at its first
+ * output
+ *
+ *     double coor[nn * 3], int32 conn[nelem * npe], int32 elem_type[nelem]
+ *
+ * and every step only adds to micropp_<gp_id>_fields.bin the record
+ *
+ *     double displ[nn * 3], strain[nelem * nvoi], stress[nelem * nvoi],
+ *     plasticity[nelem], hardening[nelem]
+ *
+ * A step written again (same time_step as the last one) replaces its
+ * record. micropp_<gp_id>.xmf is the temporal collection that points
+ * every step to its record and to the shared geometry, the grid of a new
+ * step is written before its closing tags.
+ */
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "micro.hpp"
+
+void micropp_t::write_xdmf(const vtu_snapshot_t &snap)
+{
+	const int gp_id = snap.gp_id;
+	std::stringstream prefix_s;
+	prefix_s << "micropp_" << gp_id;
+	const string prefix = prefix_s.str();
+
+	const size_t coor_bytes = nn * 3 * sizeof(double);
+	const size_t conn_bytes = nelem * npe * sizeof(int32_t);
+	const size_t rec_size = nn * 3 + 2 * nelem * nvoi + 2 * nelem;
+
+	auto it = xdmf_series.find(gp_id);
+	if (it == xdmf_series.end()) {
+		vector<double> coor;
+		vector<int32_t> conn;
+		get_grid(coor, conn);
+
+		FILE *file = fopen((prefix + "_geom.bin").c_str(), "wb");
+		if (file == NULL) {
+			cerr << "micropp : can not open " << prefix << "_geom.bin" << endl;
+			return;
+		}
+		fwrite(coor.data(), 1, coor_bytes, file);
+		fwrite(conn.data(), 1, conn_bytes, file);
+		fwrite(snap.elem_type.data(), sizeof(int32_t), nelem, file);
+		fclose(file);
+
+		file = fopen((prefix + "_fields.bin").c_str(), "wb");
+		if (file == NULL) {
+			cerr << "micropp : can not open " << prefix << "_fields.bin" << endl;
+			return;
+		}
+		fclose(file);
+		const series_t series = { 0, -1, 0 };
+		it = xdmf_series.insert(make_pair(gp_id, series)).first;
+	}
+
+	series_t &series = it->second;
+	const bool same = (series.nsteps > 0 && series.last_step == snap.time_step);
+	const long rec = same ? series.nsteps - 1 : series.nsteps;
+
+	vector<double> record(rec_size, 0.0);
+	double *r = record.data();
+	for (int n = 0; n < nn; ++n)
+		for (int d = 0; d < dim; ++d)
+			r[n * 3 + d] = snap.u[n * dim + d];
+	r += nn * 3;
+	memcpy(r, snap.elem_strain.data(), nelem * nvoi * sizeof(double));
+	r += nelem * nvoi;
+	memcpy(r, snap.elem_stress.data(), nelem * nvoi * sizeof(double));
+	r += nelem * nvoi;
+	memcpy(r, snap.plasticity.data(), nelem * sizeof(double));
+	r += nelem;
+	memcpy(r, snap.hardening.data(), nelem * sizeof(double));
+
+	FILE *file = fopen((prefix + "_fields.bin").c_str(), "r+b");
+	if (file == NULL) {
+		cerr << "micropp : can not open " << prefix << "_fields.bin" << endl;
+		return;
+	}
+	fseek(file, rec * rec_size * sizeof(double), SEEK_SET);
+	fwrite(record.data(), sizeof(double), rec_size, file);
+	fclose(file);
+
+	const string head = "<?xml version=\"1.0\" ?>\n<Xdmf Version=\"3.0\">\n<Domain>\n"
+		"<Grid Name=\"" + prefix + "\" GridType=\"Collection\" CollectionType=\"Temporal\">\n";
+	append_series(prefix + ".xmf", series, snap.time_step, head,
+	              get_xdmf_grid("step_" + to_string(snap.time_step), gp_id, snap.time_step, rec),
+	              "</Grid>\n</Domain>\n</Xdmf>\n");
+}
+
+string micropp_t::get_xdmf_grid(const string &name, const int gp_id, const int time_step,
+                                const long rec)
+{
+	// Uniform grid of the record rec of the point
+	const size_t coor_bytes = nn * 3 * sizeof(double);
+	const size_t conn_bytes = nelem * npe * sizeof(int32_t);
+	const size_t rec_size = nn * 3 + 2 * nelem * nvoi + 2 * nelem;
+
+	const uint16_t one = 1;
+	const char *endian = (*((const unsigned char *) &one) == 1) ? "Little" : "Big";
+	const string prefix = "micropp_" + to_string(gp_id);
+	const string geom = prefix + "_geom.bin", fields = prefix + "_fields.bin";
+
+	auto item = [endian](std::stringstream &x, const string &dims, const char *type,
+	                     const int prec, const size_t seek, const string &fname) {
+		x << "<DataItem Dimensions=\"" << dims << "\" NumberType=\"" << type
+		  << "\" Precision=\"" << prec << "\" Format=\"Binary\" Endian=\"" << endian
+		  << "\" Seek=\"" << seek << "\">" << fname << "</DataItem>\n";
+	};
+	auto attr = [&item, &fields](std::stringstream &x, const char *name, const char *type,
+	                             const char *center, const string &dims, const size_t seek) {
+		x << "<Attribute Name=\"" << name << "\" AttributeType=\"" << type
+		  << "\" Center=\"" << center << "\">\n";
+		item(x, dims, "Float", 8, seek, fields);
+		x << "</Attribute>\n";
+	};
+
+	const string n_dims = to_string(nn), e_dims = to_string(nelem);
+	size_t seek = rec * rec_size * sizeof(double);
+	std::stringstream x;
+	x << "<Grid Name=\"" << name << "\" GridType=\"Uniform\">\n"
+	  << "<Time Value=\"" << time_step << "\"/>\n"
+	  << "<Topology TopologyType=\"" << ((dim == 3) ? "Hexahedron" : "Quadrilateral")
+	  << "\" NumberOfElements=\"" << nelem << "\">\n";
+	item(x, e_dims + " " + to_string(npe), "Int", 4, coor_bytes, geom);
+	x << "</Topology>\n<Geometry GeometryType=\"XYZ\">\n";
+	item(x, n_dims + " 3", "Float", 8, 0, geom);
+	x << "</Geometry>\n"
+	  << "<Attribute Name=\"elem_type\" AttributeType=\"Scalar\" Center=\"Cell\">\n";
+	item(x, e_dims, "Int", 4, coor_bytes + conn_bytes, geom);
+	x << "</Attribute>\n";
+	attr(x, "displ", "Vector", "Node", n_dims + " 3", seek);
+	seek += nn * 3 * sizeof(double);
+	attr(x, "strain", "Matrix", "Cell", e_dims + " " + to_string(nvoi), seek);
+	seek += nelem * nvoi * sizeof(double);
+	attr(x, "stress", "Matrix", "Cell", e_dims + " " + to_string(nvoi), seek);
+	seek += nelem * nvoi * sizeof(double);
+	attr(x, "plasticity", "Scalar", "Cell", e_dims, seek);
+	seek += nelem * sizeof(double);
+	attr(x, "hardening", "Scalar", "Cell", e_dims, seek);
+	x << "</Grid>\n";
+	return x.str();
+}
+
+void micropp_t::append_series(const string &fname, series_t &series, const int time_step,
+                              const string &head, const string &entry, const string &tail)
+{
+	// A new step is written over the tail and the last step again over
+	// its entry, so the cost does not grow with the number of steps
+	const bool same = (series.nsteps > 0 && series.last_step == time_step);
+	FILE *file = fopen(fname.c_str(), (series.nsteps == 0) ? "wb" : "r+b");
+	if (file == NULL) {
+		cerr << "micropp : can not open " << fname << endl;
+		return;
+	}
+
+	long pos;
+	if (series.nsteps == 0) {
+		fwrite(head.data(), 1, head.size(), file);
+		pos = head.size();
+	} else if (same) {
+		pos = series.last_pos;
+	} else {
+		fseek(file, 0, SEEK_END);
+		pos = ftell(file) - tail.size();
+	}
+	fseek(file, pos, SEEK_SET);
+	fwrite(entry.data(), 1, entry.size(), file);
+	fwrite(tail.data(), 1, tail.size(), file);
+	fflush(file);
+	if (ftruncate(fileno(file), pos + entry.size() + tail.size()) != 0)
+		cerr << "micropp : can not truncate " << fname << endl;
+	fclose(file);
+
+	if (!same)
+		series.nsteps++;
+	series.last_step = time_step;
+	series.last_pos = pos;
+}
@@ -0,0 +1,169 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+
+// Builds a response table along eps_zz, loads it and compares the
+// interpolated stresses with full solves. The points in the cells with a
+// yielded node are served and become non-linear as in the full solves.
+// A point loaded in two steps inside a yielded cell is served by the
+// table, when it is unloaded it is solved from the virgin state to the
+// last strain served and it matches a full solve with that history.
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [npts]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int npts_z = (argc > 4 ? atoi(argv[4]) : 5);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1 && npts_z > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.1,		// Layer width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] =	{
+		// Material 0
+		1.0e6,	// E
+		0.3,	// nu
+		5.0e4,	// Sy
+		5.0e4,	// Ka
+		// Material 1
+		1.0e6,
+		0.3,
+		1.0e4,
+		0.0e-1 };
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	int npts[6] = {1, 1, npts_z, 1, 1, 1};
+	double eps_min[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+	double eps_max[6] = {0.0, 0.0, 0.1, 0.0, 0.0, 0.0};
+	micro.write_table("micropp_table.bin", npts, eps_min, eps_max);
+
+	const int ncheck = 2 * npts_z - 1;
+	double sig_full[ncheck * 6], sig_table[ncheck * 6];
+	double eps[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+	for (int i = 0; i < ncheck; ++i) {
+		eps[2] = i * eps_max[2] / (ncheck - 1);
+		micro.set_macro_strain(i, eps);
+	}
+	micro.homogenize();
+	micro.update_vars();
+	for (int i = 0; i < ncheck; ++i)
+		micro.get_macro_stress(i, &sig_full[i * 6]);
+
+	bool ok = micro.load_table("micropp_table.bin");
+	assert(ok);
+
+	for (int i = 0; i < ncheck; ++i) {
+		eps[2] = i * eps_max[2] / (ncheck - 1);
+		micro.set_macro_strain(100 + i, eps);
+	}
+	micro.homogenize();
+	micro.update_vars();
+	for (int i = 0; i < ncheck; ++i)
+		micro.get_macro_stress(100 + i, &sig_table[i * 6]);
+
+	int nl_last = 0;
+	for (int i = 0; i < ncheck; ++i) {
+		int nl_full, nl_table;
+		micro.get_nl_flag(i, &nl_full);
+		micro.get_nl_flag(100 + i, &nl_table);
+		assert(nl_full == nl_table);
+		nl_last = nl_full;
+	}
+	assert(nl_last == 1);
+
+	for (int i = 0; i < ncheck; ++i) {
+		double err = fabs(sig_table[i * 6 + 2] - sig_full[i * 6 + 2]) /
+			fabs(sig_full[i * 6 + 2] + 1.0e-10);
+		cout << "eps_zz = " << scientific << setw(14) << i * eps_max[2] / (ncheck - 1)
+		     << " sig_zz full = " << setw(14) << sig_full[i * 6 + 2]
+		     << " table = " << setw(14) << sig_table[i * 6 + 2]
+		     << " err = " << setw(14) << err << endl;
+		// Nodes of the table are exact up to the solver tolerance
+		if (i % 2 == 0 && i > 0)
+			assert(err < 1.0e-6);
+	}
+	cout << "table hits = " << micro.get_table_hits() << endl;
+	assert(micro.get_table_hits() > 0);
+
+	micropp_t micro_path(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_ref(dim, size, micro_type, micro_params, mat_types, mat_params);
+	ok = micro_path.load_table("micropp_table.bin");
+	assert(ok);
+	const double eps_path[3] = { 0.6 * eps_max[2], 0.8 * eps_max[2], 0.7 * eps_max[2] };
+	const double eps_ref[2] = { eps_path[1], eps_path[2] };
+
+	for (int t = 0; t < 3; ++t) {
+		eps[2] = eps_path[t];
+		micro_path.set_macro_strain(0, eps);
+		micro_path.homogenize();
+		micro_path.update_vars();
+		assert(micro_path.get_table_hits() == min(t + 1, 2));
+
+		int nl_table;
+		micro_path.get_nl_flag(0, &nl_table);
+		assert(nl_table == 1);
+	}
+	for (int t = 0; t < 2; ++t) {
+		eps[2] = eps_ref[t];
+		micro_ref.set_macro_strain(0, eps);
+		micro_ref.homogenize();
+		micro_ref.update_vars();
+	}
+
+	double sig_path[6], sig_ref[6];
+	micro_path.get_macro_stress(0, sig_path);
+	micro_ref.get_macro_stress(0, sig_ref);
+	const double err = fabs(sig_path[2] - sig_ref[2]) / fabs(sig_ref[2]);
+	cout << "unloaded from the table path sig_zz = " << sig_path[2]
+	     << " full = " << sig_ref[2] << " err = " << err << endl;
+	assert(err < 1.0e-10);
+
+	return 0;
+}
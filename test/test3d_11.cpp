@@ -0,0 +1,101 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+
+// Builds the clustering reduced model, checks it in the elastic range
+// and reports its error against the full model under plastic strains
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [nclus] [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int nclus = (argc > 4 ? atoi(argv[4]) : 4);  // Optional value
+	const int time_steps = (argc > 5 ? atoi(argv[5]) : 5);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 0;	// sphere in a matrix
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.2,		// Sphere radius
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] =	{
+		// Material 0
+		1.0e6,	// E
+		0.3,	// nu
+		5.0e3,	// Sy
+		5.0e4,	// Ka
+		// Material 1
+		1.0e7,
+		0.3,
+		1.0e4,
+		0.0e-1 };
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	micro.calc_clusters(nclus);
+
+	double eps[6] = {0.0, 0.0, 1.0e-6, 0.0, 0.0, 0.0};
+	double err = micro.get_rom_error(eps);
+	cout << "elastic err = " << scientific << err << endl;
+	assert(err < 1.0e-6);
+
+	double sig[6];
+	micro.set_rom(true);
+	for (int t = 0; t < time_steps; ++t) {
+		eps[2] += 0.004;
+		micro.set_macro_strain(1, eps);
+		micro.homogenize();
+		micro.get_macro_stress(1, sig);
+		micro.update_vars();
+
+		cout << "eps = " << setw(14) << eps[2] << " sig = " << setw(14) << sig[2] << endl;
+	}
+
+	eps[2] = 0.01;
+	cout << "plastic err = " << micro.get_rom_error(eps) << endl;
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+
+// Trains the POD reduced model with the snapshots of a full loading
+// path and repeats the path with it on another Gauss point
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [nmodes] [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int nmodes = (argc > 4 ? atoi(argv[4]) : 6);  // Optional value
+	const int time_steps = (argc > 5 ? atoi(argv[5]) : 5);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 0;	// sphere in a matrix
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.2,		// Sphere radius
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] =	{
+		// Material 0
+		1.0e6,	// E
+		0.3,	// nu
+		5.0e3,	// Sy
+		5.0e4,	// Ka
+		// Material 1
+		1.0e7,
+		0.3,
+		1.0e4,
+		0.0e-1 };
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	// Offline : full solves of gp 1 along the path
+	double eps[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+	double sig_full[time_steps][6];
+
+	micro.set_pod_snapshots(true);
+	for (int t = 0; t < time_steps; ++t) {
+		eps[2] += 0.002;
+		micro.set_macro_strain(1, eps);
+		micro.homogenize();
+		micro.get_macro_stress(1, sig_full[t]);
+		micro.update_vars();
+	}
+	micro.set_pod_snapshots(false);
+
+	int nmodes_pod, npts_pod;
+	micro.calc_pod(nmodes, 1.0e-6);
+	micro.get_pod_size(&nmodes_pod, &npts_pod);
+	cout << "modes = " << nmodes_pod << " cubature points = " << npts_pod
+	     << " of " << (nx - 1) * (ny - 1) * (nz - 1) * 8 << endl;
+
+	// Online : the same path on gp 2
+	double err_max = 0.0;
+	micro.set_pod(true);
+	eps[2] = 0.0;
+	for (int t = 0; t < time_steps; ++t) {
+		double sig[6];
+		eps[2] += 0.002;
+		micro.set_macro_strain(2, eps);
+		micro.homogenize();
+		micro.get_macro_stress(2, sig);
+		micro.update_vars();
+
+		double err = fabs(sig[2] - sig_full[t][2]) / fabs(sig_full[t][2]);
+		err_max = max(err, err_max);
+		cout << "eps = " << setw(14) << scientific << eps[2]
+		     << " sig full = " << setw(14) << sig_full[t][2]
+		     << " sig pod = " << setw(14) << sig[2] << endl;
+	}
+	cout << "max err = " << err_max << endl;
+	assert(err_max < 1.0e-2);
+
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 3
+
+// Loading and unloading with the committed int_vars compressed without and
+// with loss, compared against the uncompressed run
+
+static double rel_err(const double *a, const double *b)
+{
+	double norm = 0.0, norm_err = 0.0;
+	for (int i = 0; i < 6; ++i) {
+		norm += b[i] * b[i];
+		norm_err += (a[i] - b[i]) * (a[i] - b[i]);
+	}
+	return sqrt(norm_err / norm);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 4);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] =	{
+		// Material 0
+		1.0e6,	// E
+		0.3,	// nu
+		5.0e3,	// Sy
+		5.0e4,	// Ka
+		// Material 1
+		1.0e7,
+		0.3,
+		1.0e4,
+		0.0e-1 };
+
+	micropp_t micro_ref(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_rle(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_lossy(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	micro_rle.set_compression(true, 0.0);
+	micro_lossy.set_compression(true, 1.0e-9);
+
+	double err_rle = 0.0, err_lossy = 0.0;
+	for (int t = 0; t < time_steps; ++t) {
+
+		const double eps_t = 0.005 * ((t < 3) ? (t + 1) : (5 - t));
+		for (int p = 0; p < ngp; ++p) {
+			double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			eps[p] = eps_t;
+			eps[3 + p] = 0.001 * p;
+			micro_ref.set_macro_strain(p, eps);
+			micro_rle.set_macro_strain(p, eps);
+			micro_lossy.set_macro_strain(p, eps);
+		}
+
+		micro_ref.homogenize();
+		micro_rle.homogenize();
+		micro_lossy.homogenize();
+
+		for (int p = 0; p < ngp; ++p) {
+			double sig_ref[6], sig[6];
+			micro_ref.get_macro_stress(p, sig_ref);
+			micro_rle.get_macro_stress(p, sig);
+			err_rle = max(err_rle, rel_err(sig, sig_ref));
+			micro_lossy.get_macro_stress(p, sig);
+			err_lossy = max(err_lossy, rel_err(sig, sig_ref));
+		}
+
+		micro_ref.update_vars();
+		micro_rle.update_vars();
+		micro_lossy.update_vars();
+
+		size_t raw, comp_rle, comp_lossy;
+		micro_rle.get_compression_stats(&raw, &comp_rle);
+		micro_lossy.get_compression_stats(&raw, &comp_lossy);
+		cout << "step " << t << " raw = " << raw << " rle = " << comp_rle
+		     << " lossy = " << comp_lossy << endl;
+		assert(comp_rle <= raw + ngp * 9);
+		assert(comp_lossy <= comp_rle);
+	}
+
+	cout << "err rle = " << scientific << err_rle << " err lossy = " << err_lossy << endl;
+	assert(err_rle < 1.0e-8);
+	assert(err_lossy < 1.0e-4);
+
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 6
+
+// Points loaded in pairs with the same strain get bit identical states
+// from the cache, so they share their committed int_vars. The stresses
+// match the run without cache and deduplication.
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 3);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] =	{
+		// Material 0
+		1.0e6,	// E
+		0.3,	// nu
+		5.0e3,	// Sy
+		5.0e4,	// Ka
+		// Material 1
+		1.0e7,
+		0.3,
+		1.0e4,
+		0.0e-1 };
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_ref(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	micro.set_cache(true, 0.0, 64);
+	micro.set_dedup(true);
+
+	long logical, physical;
+	for (int t = 0; t < time_steps; ++t) {
+
+		for (int p = 0; p < ngp; ++p) {
+			double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			eps[(p / 2) % 3] = 0.005 * (t + 1);
+			micro.set_macro_strain(p, eps);
+			micro_ref.set_macro_strain(p, eps);
+		}
+
+		micro.homogenize();
+		micro_ref.homogenize();
+
+		for (int p = 0; p < ngp; ++p) {
+			double sig[6], sig_ref[6];
+			micro.get_macro_stress(p, sig);
+			micro_ref.get_macro_stress(p, sig_ref);
+			double norm = 0.0, norm_err = 0.0;
+			for (int i = 0; i < 6; ++i) {
+				norm += sig_ref[i] * sig_ref[i];
+				norm_err += (sig[i] - sig_ref[i]) * (sig[i] - sig_ref[i]);
+			}
+			assert(sqrt(norm_err) <= 1.0e-8 * sqrt(norm));
+		}
+
+		micro.update_vars();
+		micro_ref.update_vars();
+
+		micro.get_dedup_stats(&logical, &physical);
+		cout << "step " << t << " blocks = " << logical << " distinct = " << physical << endl;
+	}
+
+	// One block per pair of points
+	assert(logical == 2 * ngp && physical == ngp / 2);
+
+	return 0;
+}
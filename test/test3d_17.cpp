@@ -0,0 +1,150 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 4
+
+// Every step is first tried with a larger strain and rolled back, as a
+// macro solver does on a cutback. The stresses match the runs that only
+// see the accepted strains, also with the compression and deduplication.
+// The points that yield for the first time in a rejected trial are elastic
+// again after the rollback and hold no int_vars.
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 3);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] =	{
+		// Material 0
+		1.0e6,	// E
+		0.3,	// nu
+		5.0e3,	// Sy
+		5.0e4,	// Ka
+		// Material 1
+		1.0e7,
+		0.3,
+		1.0e4,
+		0.0e-1 };
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_c(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_d(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_ref(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t *micros[3] = { &micro, &micro_c, &micro_d };
+
+	micro_c.set_compression(true, 0.0);
+	micro_d.set_dedup(true);
+
+	for (int t = 0; t < time_steps; ++t) {
+
+		// Rejected trial
+		for (int p = 0; p < ngp; ++p) {
+			double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			eps[p % 3] = 0.005 * (t + 3);
+			for (int m = 0; m < 3; ++m)
+				micros[m]->set_macro_strain(p, eps);
+		}
+		for (int m = 0; m < 3; ++m) {
+			micros[m]->homogenize();
+			micros[m]->rollback_vars();
+		}
+		if (t == 0)
+			for (int m = 0; m < 3; ++m) {
+				size_t reserved, in_use;
+				micros[m]->get_arena_stats(&reserved, &in_use);
+				assert(in_use == 0);
+				for (int p = 0; p < ngp; ++p) {
+					int non_linear;
+					micros[m]->get_nl_flag(p, &non_linear);
+					assert(non_linear == 0);
+				}
+			}
+
+		// Accepted step
+		for (int p = 0; p < ngp; ++p) {
+			double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			eps[p % 3] = 0.005 * (t + 1);
+			for (int m = 0; m < 3; ++m)
+				micros[m]->set_macro_strain(p, eps);
+			micro_ref.set_macro_strain(p, eps);
+		}
+		for (int m = 0; m < 3; ++m)
+			micros[m]->homogenize();
+		micro_ref.homogenize();
+
+		for (int p = 0; p < ngp; ++p) {
+			double sig_ref[6];
+			micro_ref.get_macro_stress(p, sig_ref);
+			for (int m = 0; m < 3; ++m) {
+				double sig[6];
+				micros[m]->get_macro_stress(p, sig);
+				double norm = 0.0, norm_err = 0.0;
+				for (int i = 0; i < 6; ++i) {
+					norm += sig_ref[i] * sig_ref[i];
+					norm_err += (sig[i] - sig_ref[i]) * (sig[i] - sig_ref[i]);
+				}
+				assert(sqrt(norm_err) <= 1.0e-8 * sqrt(norm));
+			}
+		}
+
+		for (int m = 0; m < 3; ++m)
+			micros[m]->update_vars();
+		micro_ref.update_vars();
+
+		int non_linear;
+		micro_ref.get_nl_flag(0, &non_linear);
+		cout << "step " << t << " non linear = " << non_linear << endl;
+	}
+
+	return 0;
+}
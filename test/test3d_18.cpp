@@ -0,0 +1,168 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "micro.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+#define dim 3
+#define nmaterials 2
+
+// The same snapshot is written in ASCII, raw appended and zlib appended
+// VTU and the displacements read back from the binary files match the
+// ASCII ones.
+
+static string read_file(const char *fname)
+{
+	ifstream file(fname, ios::binary);
+	stringstream ss;
+	ss << file.rdbuf();
+	return ss.str();
+}
+
+static size_t array_pos(const string &vtu, const char *name)
+{
+	// Position of the array in the appended data
+	size_t pos = vtu.find(string("Name=\"") + name + "\"");
+	pos = vtu.find("offset=\"", pos) + 8;
+	return vtu.find("_", vtu.find("<AppendedData")) + 1 + atol(vtu.c_str() + pos);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int nn = nx * ny * nz;
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	double eps[6] = { 0.01, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	micro.set_macro_strain(0, eps);
+	micro.homogenize();
+	micro.update_vars();
+
+	const int formats[3] = { VTU_ASCII, VTU_RAW, VTU_ZLIB };
+	string vtu[3];
+	for (int f = 0; f < 3; ++f) {
+		const bool ok = micro.set_vtu_format(formats[f]);
+		auto start = high_resolution_clock::now();
+		micro.output(f, 0);
+		auto time = duration_cast<milliseconds>(high_resolution_clock::now() - start);
+
+		stringstream fname;
+		fname << "micropp_0_" << f << ".vtu";
+		vtu[f] = read_file(fname.str().c_str());
+		remove(fname.str().c_str());
+		cout << "format " << formats[f] << (ok ? "" : " (raw)") << " bytes = "
+		     << vtu[f].size() << " time = " << time.count() << " ms" << endl;
+	}
+
+	// ASCII displacements
+	vector<double> displ_a(nn * 3);
+	size_t pos = vtu[0].find("Name=\"displ\"");
+	stringstream ss(vtu[0].substr(vtu[0].find(">", pos) + 1));
+	for (int i = 0; i < nn * 3; ++i)
+		ss >> displ_a[i];
+
+	// Raw displacements
+	uint64_t bytes;
+	pos = array_pos(vtu[1], "displ");
+	memcpy(&bytes, &vtu[1][pos], sizeof(uint64_t));
+	assert(bytes == nn * 3 * sizeof(double));
+	vector<double> displ_r(nn * 3);
+	memcpy(displ_r.data(), &vtu[1][pos + sizeof(uint64_t)], bytes);
+
+	// The ASCII file has 6 significant digits
+	double norm = 0.0;
+	for (int i = 0; i < nn * 3; ++i)
+		norm = max(norm, fabs(displ_r[i]));
+	assert(norm > 0.0);
+	for (int i = 0; i < nn * 3; ++i)
+		assert(fabs(displ_r[i] - displ_a[i]) <= 1.0e-5 * norm);
+
+#ifdef HAVE_ZLIB
+	assert(vtu[2].size() < vtu[0].size() && vtu[2].size() < vtu[1].size());
+
+	uint64_t header[3];
+	pos = array_pos(vtu[2], "displ");
+	memcpy(header, &vtu[2][pos], 3 * sizeof(uint64_t));
+	const uint64_t nblocks = header[0];
+	vector<unsigned char> displ_z(nn * 3 * sizeof(double));
+	size_t in = pos + (3 + nblocks) * sizeof(uint64_t);
+	for (uint64_t b = 0; b < nblocks; ++b) {
+		uint64_t csize;
+		memcpy(&csize, &vtu[2][pos + (3 + b) * sizeof(uint64_t)], sizeof(uint64_t));
+		uLongf n = displ_z.size() - b * header[1];
+		uncompress(&displ_z[b * header[1]], &n, (const Bytef *) &vtu[2][in], csize);
+		in += csize;
+	}
+	assert(memcmp(displ_z.data(), displ_r.data(), displ_z.size()) == 0);
+#endif
+
+	return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 4
+
+// The same steps are run with synchronous output and with the background
+// writer (with a queue of one job, so that the compute thread waits for
+// it). The files written are the same.
+
+static const char *info_files[3] = { "micropp_convergence.dat",
+                                     "micropp_eps_sig_ctan.dat",
+                                     "micropp_int_vars_n.dat" };
+
+static string read_file(const string &fname)
+{
+	ifstream file(fname, ios::binary);
+	stringstream ss;
+	ss << file.rdbuf();
+	return ss.str();
+}
+
+static double run(const int size[3], const int time_steps, const bool async, const int format)
+{
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	for (int f = 0; f < 3; ++f)
+		remove(info_files[f]);
+
+	auto start = high_resolution_clock::now();
+	{
+		micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+		micro.set_vtu_format(format);
+		if (async)
+			micro.set_async_output(true, 1);
+
+		for (int t = 0; t < time_steps; ++t) {
+			for (int p = 0; p < ngp; ++p) {
+				double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+				eps[p % 3] = 0.002 * (t + 1);
+				micro.set_macro_strain(p, eps);
+			}
+			micro.homogenize();
+			micro.output(t, 0);
+			micro.update_vars();
+			micro.write_info_files();
+		}
+		// The queued output is written at destruction
+	}
+	return duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 3);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	const int size[dim] = {nx, ny, nz};
+
+	for (int format = VTU_ASCII; format <= VTU_RAW; ++format) {
+		string ref[3], ref_vtu[10];
+		const double time_sync = run(size, time_steps, false, format);
+		for (int f = 0; f < 3; ++f)
+			ref[f] = read_file(info_files[f]);
+		for (int t = 0; t < time_steps; ++t)
+			ref_vtu[t] = read_file("micropp_0_" + to_string(t) + ".vtu");
+
+		const double time_async = run(size, time_steps, true, format);
+		for (int f = 0; f < 3; ++f) {
+			assert(ref[f].size() > 0);
+			assert(read_file(info_files[f]) == ref[f]);
+			remove(info_files[f]);
+		}
+		for (int t = 0; t < time_steps; ++t) {
+			const string fname = "micropp_0_" + to_string(t) + ".vtu";
+			assert(read_file(fname) == ref_vtu[t]);
+			remove(fname.c_str());
+		}
+
+		cout << "format " << format << " sync = " << time_sync << " ms async = "
+		     << time_async << " ms" << endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 4
+
+// The binary log of a few steps, written by the background writer, holds
+// the stresses of the points at every step and the int_vars of the
+// non-linear points every other step.
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 3);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	vector<double> stress(time_steps * ngp * 6);
+	int nl_records = 0;
+	{
+		micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+		micro.set_async_output(true, 2);
+		assert(micro.open_log("micropp_log", 2));
+
+		for (int t = 0; t < time_steps; ++t) {
+			for (int p = 0; p < ngp; ++p) {
+				double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+				eps[p % 3] = 0.004 * (t + 1) * (p + 1) / ngp;
+				micro.set_macro_strain(p, eps);
+			}
+			micro.homogenize();
+			micro.update_vars();
+			micro.write_log();
+
+			for (int p = 0; p < ngp; ++p) {
+				micro.get_macro_stress(p, &stress[(t * ngp + p) * 6]);
+				int non_linear;
+				micro.get_nl_flag(p, &non_linear);
+				if (t % 2 == 0 && non_linear)
+					nl_records++;
+			}
+		}
+		micro.close_log();
+	}
+	assert(nl_records > 0);
+
+	// Header
+	FILE *file = fopen("micropp_log.hdr", "rb");
+	char magic[8];
+	int32_t head[6];
+	assert(fread(magic, 1, 8, file) == 8 && memcmp(magic, "MICROPPL", 8) == 0);
+	assert(fread(head, sizeof(int32_t), 6, file) == 6);
+	assert(head[1] == 6 && head[2] == ngp && head[3] == 7 && head[5] == 2);
+	const int num_int_vars = head[4];
+	int stress_width = 0;
+	for (int c = 0; c < head[3]; ++c) {
+		char name[16];
+		int32_t desc[2];
+		assert(fread(name, 1, 16, file) == 16);
+		assert(fread(desc, sizeof(int32_t), 2, file) == 2);
+		if (strcmp(name, "stress") == 0)
+			stress_width = desc[1];
+	}
+	int32_t gp_id[ngp];
+	assert(fread(gp_id, sizeof(int32_t), ngp, file) == ngp);
+	fclose(file);
+	assert(stress_width == 6 && gp_id[ngp - 1] == ngp - 1);
+
+	// Stress column
+	vector<double> stress_log(time_steps * ngp * 6);
+	file = fopen("micropp_log_stress.bin", "rb");
+	assert(fread(stress_log.data(), sizeof(double), stress_log.size(), file) == stress_log.size());
+	assert(fgetc(file) == EOF);
+	fclose(file);
+	assert(stress_log == stress);
+
+	// Sparse int_vars records
+	int records = 0;
+	file = fopen("micropp_log_int_vars.bin", "rb");
+	vector<double> int_vars(num_int_vars);
+	int32_t rec[2];
+	while (fread(rec, sizeof(int32_t), 2, file) == 2) {
+		assert(fread(int_vars.data(), sizeof(double), num_int_vars, file) == (size_t) num_int_vars);
+		assert(rec[0] % 2 == 0);
+		records++;
+	}
+	fclose(file);
+	cout << "int_vars records = " << records << endl;
+	assert(records == nl_records);
+
+	return 0;
+}
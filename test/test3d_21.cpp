@@ -0,0 +1,155 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+
+#include "micro.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 4
+
+// output() of the watched points reuses the displacements of homogenize
+// and matches the one that solves them again.
+
+static vector<double> read_displ(const string &fname, const int nn)
+{
+	ifstream file(fname, ios::binary);
+	stringstream ss;
+	ss << file.rdbuf();
+	const string vtu = ss.str();
+	remove(fname.c_str());
+
+	size_t pos = vtu.find("Name=\"displ\"");
+	pos = vtu.find("offset=\"", pos) + 8;
+	pos = vtu.find("_", vtu.find("<AppendedData")) + 1 + atol(vtu.c_str() + pos);
+
+	vector<double> displ(nn * 3);
+	memcpy(displ.data(), &vtu[pos + sizeof(uint64_t)], nn * 3 * sizeof(double));
+	return displ;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int nn = nx * ny * nz;
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 3);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_ref(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micro.set_vtu_format(VTU_RAW);
+	micro_ref.set_vtu_format(VTU_RAW);
+
+	const int watched[2] = { 1, 2 };
+	micro.set_watch(2, watched);
+
+	double time = 0.0, time_ref = 0.0;
+	for (int t = 0; t < time_steps; ++t) {
+
+		for (int p = 0; p < ngp; ++p) {
+			double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			eps[p % 3] = 0.002 * (t + 1);
+			micro.set_macro_strain(p, eps);
+			micro_ref.set_macro_strain(p, eps);
+		}
+		micro.homogenize();
+		micro_ref.homogenize();
+
+		for (int p = 0; p < ngp; ++p) {
+			auto start = high_resolution_clock::now();
+			micro.output(t, p);
+			auto end = high_resolution_clock::now();
+			const vector<double> displ = read_displ("micropp_" + to_string(p) + "_" + to_string(t) + ".vtu", nn);
+
+			auto start_ref = high_resolution_clock::now();
+			micro_ref.output(t, p);
+			auto end_ref = high_resolution_clock::now();
+			const vector<double> displ_ref = read_displ("micropp_" + to_string(p) + "_" + to_string(t) + ".vtu", nn);
+
+			if (p == watched[0] || p == watched[1]) {
+				time += duration_cast<microseconds>(end - start).count();
+				time_ref += duration_cast<microseconds>(end_ref - start_ref).count();
+			}
+
+			double norm = 0.0, norm_err = 0.0;
+			for (int i = 0; i < nn * 3; ++i) {
+				norm = max(norm, fabs(displ_ref[i]));
+				norm_err = max(norm_err, fabs(displ[i] - displ_ref[i]));
+			}
+			assert(norm_err <= 1.0e-6 * norm);
+		}
+
+		micro.update_vars();
+		micro_ref.update_vars();
+	}
+
+	long hits, solves;
+	micro.get_watch_stats(&hits, &solves);
+	cout << "hits = " << hits << " solves = " << solves << endl;
+	cout << "watched output " << time / 1000 << " ms, solving again " << time_ref / 1000 << " ms" << endl;
+	assert(hits == 2 * time_steps && solves == (ngp - 2) * time_steps);
+
+	return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 5
+
+// A run restarted from the checkpoint of its middle step continues as
+// the one that was not stopped, with the int_vars mapped from the file,
+// with them copied into the compressed storage and with them shared by
+// the deduplication, which can be turned off afterwards. The mapped rows
+// are the only int_vars blocks of the restored points until they solve.
+
+static void set_strains(micropp_t &micro, const int t)
+{
+	for (int p = 0; p < ngp; ++p) {
+		double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+		eps[p % 6] = (p < ngp - 1) ? 0.005 * (t + 1) : 0.0;
+		micro.set_macro_strain(p, eps);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 4);  // Optional value
+	const int ckpt_step = time_steps / 2;
+
+	assert(nx > 1 && ny > 1 && nz > 1 && time_steps > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	const char *fname = "micropp_ckpt.bin";
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_r(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_c(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_d(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micro.set_async_output(true, 2);
+	micro_c.set_compression(true, 0.0);
+	micro_d.set_dedup(true);
+
+	for (int t = 0; t < time_steps; ++t) {
+
+		set_strains(micro, t);
+		micro.homogenize();
+		micro.update_vars();
+
+		if (t == ckpt_step) {
+			micro.write_checkpoint(fname);
+			micro.io_flush();
+			assert(micro_r.load_checkpoint(fname));
+			assert(micro_c.load_checkpoint(fname));
+			assert(micro_d.load_checkpoint(fname));
+
+			// micro holds the committed and trial blocks of the yielded
+			// points, micro_r only their mapped rows
+			size_t reserved, in_use, in_use_r;
+			micro.get_arena_stats(&reserved, &in_use);
+			micro_r.get_arena_stats(&reserved, &in_use_r);
+			assert(in_use_r * 2 == in_use);
+
+			// The ngp - 1 yielded points have different int_vars
+			long logical, physical;
+			micro_d.get_dedup_stats(&logical, &physical);
+			assert(logical == 2 * (ngp - 1) && physical == ngp - 1);
+			micro_d.set_dedup(false);
+			micro_d.set_dedup(true);
+
+			int nl_flag;
+			micro_r.get_nl_flag(0, &nl_flag);
+			assert(nl_flag == 1);
+			micro_r.get_nl_flag(ngp - 1, &nl_flag);
+			assert(nl_flag == 0);
+
+			double stress[6], stress_r[6];
+			for (int p = 0; p < ngp; ++p) {
+				micro.get_macro_stress(p, stress);
+				micro_r.get_macro_stress(p, stress_r);
+				for (int i = 0; i < 6; ++i)
+					assert(stress[i] == stress_r[i]);
+			}
+			continue;
+		}
+		if (t < ckpt_step)
+			continue;
+
+		set_strains(micro_r, t);
+		set_strains(micro_c, t);
+		set_strains(micro_d, t);
+		micro_r.homogenize();
+		micro_c.homogenize();
+		micro_d.homogenize();
+		micro_r.update_vars();
+		micro_c.update_vars();
+		micro_d.update_vars();
+
+		cout << "t = " << t << endl;
+		for (int p = 0; p < ngp; ++p) {
+			double stress[6], stress_r[6], stress_c[6], stress_d[6];
+			micro.get_macro_stress(p, stress);
+			micro_r.get_macro_stress(p, stress_r);
+			micro_c.get_macro_stress(p, stress_c);
+			micro_d.get_macro_stress(p, stress_d);
+
+			double norm = 0.0, err_r = 0.0, err_c = 0.0, err_d = 0.0;
+			for (int i = 0; i < 6; ++i) {
+				norm = max(norm, fabs(stress[i]));
+				err_r = max(err_r, fabs(stress_r[i] - stress[i]));
+				err_c = max(err_c, fabs(stress_c[i] - stress[i]));
+				err_d = max(err_d, fabs(stress_d[i] - stress[i]));
+			}
+			cout << "gp " << p << " stress[" << p % 6 << "] = " << stress[p % 6]
+			     << " err restart = " << err_r << " compressed = " << err_c
+			     << " shared = " << err_d << endl;
+			assert(err_r <= 1.0e-6 * norm && err_c <= 1.0e-6 * norm &&
+			       err_d <= 1.0e-6 * norm);
+		}
+	}
+
+	// Another micro-structure is rejected
+	int size_o[dim] = {nx + 1, ny, nz};
+	micropp_t micro_o(dim, size_o, micro_type, micro_params, mat_types, mat_params);
+	assert(!micro_o.load_checkpoint(fname));
+
+	remove(fname);
+	return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 2
+
+// The XDMF fields of every step are those of the VTU, the geometry is
+// written once and each step only adds its fields and its grid.
+
+static string read_file(const string &fname)
+{
+	ifstream file(fname, ios::binary);
+	stringstream ss;
+	ss << file.rdbuf();
+	return ss.str();
+}
+
+static vector<double> read_vtu_array(const string &vtu, const char *name, const size_t n)
+{
+	size_t pos = vtu.find("Name=\"" + string(name) + "\"");
+	pos = vtu.find("offset=\"", pos) + 8;
+	pos = vtu.find("_", vtu.find("<AppendedData")) + 1 + atol(vtu.c_str() + pos);
+
+	vector<double> array(n);
+	memcpy(array.data(), &vtu[pos + sizeof(uint64_t)], n * sizeof(double));
+	return array;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int nn = nx * ny * nz;
+	const int nelem = (nx - 1) * (ny - 1) * (nz - 1);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 3);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	// The watched points give the same u to both outputs
+	const int watched[ngp] = { 0, 1 };
+	micro.set_watch(ngp, watched);
+
+	const size_t rec_size = nn * 3 + 2 * nelem * 6 + 2 * nelem;
+	size_t vtu_bytes = 0;
+
+	for (int t = 0; t < time_steps; ++t) {
+
+		for (int p = 0; p < ngp; ++p) {
+			double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			eps[p] = 0.005 * (t + 1);
+			micro.set_macro_strain(p, eps);
+		}
+		micro.homogenize();
+
+		for (int p = 0; p < ngp; ++p) {
+			const string fname = "micropp_" + to_string(p) + "_" + to_string(t) + ".vtu";
+			micro.set_vtu_format(VTU_RAW);
+			micro.output(t, p);
+			const string vtu = read_file(fname);
+			remove(fname.c_str());
+			vtu_bytes += vtu.size();
+			const vector<double> displ = read_vtu_array(vtu, "displ", nn * 3);
+			const vector<double> stress = read_vtu_array(vtu, "stress", nelem * 6);
+			const vector<double> hardening = read_vtu_array(vtu, "hardening", nelem);
+
+			micro.set_vtu_format(VTU_XDMF);
+			micro.output(t, p);
+
+			const string fields = read_file("micropp_" + to_string(p) + "_fields.bin");
+			assert(fields.size() == (t + 1) * rec_size * sizeof(double));
+			const double *rec = (const double *) &fields[t * rec_size * sizeof(double)];
+			assert(memcmp(rec, displ.data(), nn * 3 * sizeof(double)) == 0);
+			rec += nn * 3 + nelem * 6;
+			assert(memcmp(rec, stress.data(), nelem * 6 * sizeof(double)) == 0);
+			rec += nelem * 6 + nelem;
+			assert(memcmp(rec, hardening.data(), nelem * sizeof(double)) == 0);
+		}
+
+		micro.update_vars();
+	}
+
+	// Writing the last step again replaces its record
+	micro.output(time_steps - 1, 0);
+
+	size_t xdmf_bytes = 0;
+	for (int p = 0; p < ngp; ++p) {
+		const string prefix = "micropp_" + to_string(p);
+		const string geom = read_file(prefix + "_geom.bin");
+		const string fields = read_file(prefix + "_fields.bin");
+		const string xmf = read_file(prefix + ".xmf");
+		assert(geom.size() == nn * 3 * sizeof(double) + nelem * 9 * sizeof(int32_t));
+		assert(fields.size() == time_steps * rec_size * sizeof(double));
+		assert(xmf.find("CollectionType=\"Temporal\"") != string::npos);
+
+		int ntimes = 0;
+		for (size_t pos = xmf.find("<Time "); pos != string::npos; pos = xmf.find("<Time ", pos + 1))
+			ntimes++;
+		assert(ntimes == time_steps);
+		const string tail = "</Grid>\n</Domain>\n</Xdmf>\n";
+		assert(xmf.find("</Xdmf>") == xmf.size() - 8 &&
+		       xmf.compare(xmf.size() - tail.size(), tail.size(), tail) == 0);
+
+		xdmf_bytes += geom.size() + fields.size() + xmf.size();
+		remove((prefix + "_geom.bin").c_str());
+		remove((prefix + "_fields.bin").c_str());
+		remove((prefix + ".xmf").c_str());
+	}
+
+	cout << "VTU bytes = " << vtu_bytes << " XDMF bytes = " << xdmf_bytes << endl;
+	return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 3
+
+// The in-situ statistics of the solved points add up to their macro
+// stresses and only the plastic phase has a plastic volume fraction.
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps] [stride]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 3);  // Optional value
+	const int stride = (argc > 5 ? atoi(argv[5]) : 2);
+
+	assert(nx > 1 && ny > 1 && nz > 1 && stride > 0);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	const char *fname = "micropp_stats.bin";
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+	assert(micro.open_stats(fname, stride));
+
+	const int nc = (nx - 2) / stride + 1, ncoarse = nc * ((ny - 2) / stride + 1) *
+		((nz - 2) / stride + 1);
+	const int rec_size = micro.get_stats_size();
+	assert(rec_size == nmaterials * 9 + STATS_BINS + ncoarse);
+	vector<double> rec(rec_size);
+
+	for (int t = 0; t < time_steps; ++t) {
+
+		double eps[ngp][6] = { { 0.0 } };
+		eps[0][0] = 0.01 * (t + 1);	// plastic
+		eps[1][1] = 1.0e-6;		// elastic, solved
+		for (int p = 0; p < ngp; ++p)
+			micro.set_macro_strain(p, eps[p]);
+
+		micro.homogenize();
+		micro.write_stats(t);
+
+		for (int p = 0; p < 2; ++p) {
+			assert(micro.get_stats(p, rec.data()));
+
+			double stress[6], frac = 0.0, plastic = 0.0, hist = 0.0, vm_max = 0.0;
+			micro.get_macro_stress(p, stress);
+			for (int i = 0; i < 6; ++i) {
+				double ave = 0.0;
+				for (int ph = 0; ph < nmaterials; ++ph)
+					ave += rec[ph * 9] * rec[ph * 9 + 1 + i];
+				assert(fabs(ave - stress[i]) <= 1.0e-8 * (fabs(stress[i]) + 1.0));
+			}
+			for (int ph = 0; ph < nmaterials; ++ph) {
+				frac += rec[ph * 9];
+				plastic += rec[ph * 9] * rec[ph * 9 + 8];
+				vm_max = max(vm_max, rec[ph * 9 + 7]);
+			}
+			for (int b = 0; b < STATS_BINS; ++b)
+				hist += rec[nmaterials * 9 + b];
+			for (int c = 0; c < ncoarse; ++c)
+				assert(rec[nmaterials * 9 + STATS_BINS + c] <= vm_max);
+
+			cout << "t = " << t << " gp = " << p << " vm_max = " << vm_max
+			     << " plastic fraction = " << plastic << endl;
+			assert(fabs(frac - 1.0) < 1.0e-12 && fabs(hist - 1.0) < 1.0e-12);
+			assert(rec[1 * 9 + 8] == 0.0);
+			assert(p == 1 || plastic > 0.0);
+		}
+
+		// The linear point is not solved
+		assert(!micro.get_stats(2, rec.data()));
+
+		micro.update_vars();
+	}
+	micro.close_stats();
+
+	ifstream file(fname, ios::binary | ios::ate);
+	const size_t bytes = file.tellg();
+	assert(bytes == 8 + 9 * 4 + time_steps * 2 * (8 + rec_size * sizeof(double)));
+	cout << "stats bytes = " << bytes << endl;
+	remove(fname);
+
+	return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+
+#include <cstdio>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+#define dim 3
+#define nmaterials 2
+
+// The collective output writes the same VTU as output() of every point
+// and indexes them in one .vtm per step and the micropp.pvd collection.
+// With XDMF micropp.xmf has a spatial collection of the points per step.
+
+static string read_file(const string &fname)
+{
+	ifstream file(fname, ios::binary);
+	stringstream ss;
+	ss << file.rdbuf();
+	return ss.str();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps] [ngp] [nthreads]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 2);  // Optional value
+	const int ngp = (argc > 5 ? atoi(argv[5]) : 8);
+	const int nthreads = (argc > 6 ? atoi(argv[6]) : 4);
+
+	assert(nx > 1 && ny > 1 && nz > 1 && ngp > 0);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micro.set_vtu_format(VTU_ZLIB);
+
+	// The watched points give the same u to both outputs
+	vector<int> gp_id(ngp);
+	for (int p = 0; p < ngp; ++p)
+		gp_id[p] = 10 + p;
+	micro.set_watch(ngp, gp_id.data());
+
+	double time = 0.0, time_coll = 0.0;
+	for (int t = 0; t < time_steps; ++t) {
+
+		for (int p = 0; p < ngp; ++p) {
+			double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			eps[p % 6] = 0.005 * (t + 1);
+			micro.set_macro_strain(gp_id[p], eps);
+		}
+		micro.homogenize();
+
+		vector<string> vtu(ngp);
+		auto start = high_resolution_clock::now();
+		for (int p = 0; p < ngp; ++p)
+			micro.output(t, gp_id[p]);
+		auto end = high_resolution_clock::now();
+		time += duration_cast<microseconds>(end - start).count();
+		for (int p = 0; p < ngp; ++p) {
+			const string fname = "micropp_" + to_string(gp_id[p]) + "_" + to_string(t) + ".vtu";
+			vtu[p] = read_file(fname);
+			remove(fname.c_str());
+		}
+
+		start = high_resolution_clock::now();
+		micro.output_collective(t, ngp, gp_id.data(), nthreads);
+		end = high_resolution_clock::now();
+		time_coll += duration_cast<microseconds>(end - start).count();
+
+		const string vtm = read_file("micropp_" + to_string(t) + ".vtm");
+		for (int p = 0; p < ngp; ++p) {
+			const string fname = "micropp_" + to_string(gp_id[p]) + "_" + to_string(t) + ".vtu";
+			assert(read_file(fname) == vtu[p]);
+			assert(vtm.find("file=\"" + fname + "\"") != string::npos);
+			remove(fname.c_str());
+		}
+		remove(("micropp_" + to_string(t) + ".vtm").c_str());
+
+		micro.update_vars();
+	}
+
+	const string pvd = read_file("micropp.pvd");
+	for (int t = 0; t < time_steps; ++t)
+		assert(pvd.find("file=\"micropp_" + to_string(t) + ".vtm\"") != string::npos);
+	remove("micropp.pvd");
+
+	micro.set_vtu_format(VTU_XDMF);
+	for (int t = 0; t < time_steps; ++t)
+		micro.output_collective(t, ngp, gp_id.data(), nthreads);
+	micro.io_flush();
+
+	const string xmf = read_file("micropp.xmf");
+	int nsteps = 0, ngrids = 0;
+	for (size_t pos = xmf.find("CollectionType=\"Spatial\""); pos != string::npos;
+	     pos = xmf.find("CollectionType=\"Spatial\"", pos + 1))
+		nsteps++;
+	for (size_t pos = xmf.find("<Grid Name=\"gp_"); pos != string::npos;
+	     pos = xmf.find("<Grid Name=\"gp_", pos + 1))
+		ngrids++;
+	assert(nsteps == time_steps && ngrids == time_steps * ngp);
+	assert(xmf.find("</Xdmf>") == xmf.size() - 8);
+	remove("micropp.xmf");
+	for (int p = 0; p < ngp; ++p) {
+		const string prefix = "micropp_" + to_string(gp_id[p]);
+		remove((prefix + "_geom.bin").c_str());
+		remove((prefix + "_fields.bin").c_str());
+		remove((prefix + ".xmf").c_str());
+	}
+
+	cout << "output() " << time / 1000 << " ms, collective with " << nthreads
+	     << " threads " << time_coll / 1000 << " ms" << endl;
+	return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+#define dim 3
+#define nmaterials 2
+
+// The layers of micro_type 1 written as a voxel image (with a header and
+// at twice the resolution of the mesh) give the same stresses as the
+// analytic geometry. An image with unknown phases is rejected, and one
+// with a third material equal to the second one gives the same stresses.
+
+static void write_image(const char *fname, const int nex[3], const int rep,
+                        const double dy, const double width, const int offset,
+                        const int bad_phase, const bool split)
+{
+	const int nv[3] = { nex[0] * rep, nex[1] * rep, nex[2] * rep };
+	vector<uint8_t> img(offset + nv[0] * nv[1] * nv[2], 0xff);
+	for (int vz = 0; vz < nv[2]; ++vz)
+		for (int vy = 0; vy < nv[1]; ++vy)
+			for (int vx = 0; vx < nv[0]; ++vx) {
+				const double y = (vy / rep) * dy + dy / 2;
+				const bool half = split && (vx >= nv[0] / 2);
+				img[offset + (vz * nv[1] + vy) * nv[0] + vx] = (y < width) ? 1 + half : 0;
+			}
+	if (bad_phase > 0)
+		img[offset + nv[0] * nv[1] * nv[2] / 2] = bad_phase;
+
+	FILE *file = fopen(fname, "wb");
+	fwrite(img.data(), 1, img.size(), file);
+	fclose(file);
+}
+
+static void solve(micropp_t &micro, const int ngp, const int time_steps, double *stress)
+{
+	for (int t = 0; t < time_steps; ++t) {
+		for (int p = 0; p < ngp; ++p) {
+			double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			eps[p % 6] = 0.005 * (t + 1);
+			micro.set_macro_strain(p, eps);
+		}
+		micro.homogenize();
+		for (int p = 0; p < ngp; ++p)
+			micro.get_macro_stress(p, &stress[(t * ngp + p) * 6]);
+		micro.update_vars();
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 2);  // Optional value
+	const int ngp = 2;
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	int mat_types_3[3] = {1, 0, 0};
+	double mat_params_3[3 * MAX_MAT_PARAM];
+	for (int i = 0; i < 2 * MAX_MAT_PARAM; ++i)
+		mat_params_3[i] = mat_params[i];
+	for (int i = 0; i < MAX_MAT_PARAM; ++i)
+		mat_params_3[2 * MAX_MAT_PARAM + i] = mat_params[MAX_MAT_PARAM + i];
+
+	const int nex[3] = { nx - 1, ny - 1, nz - 1 };
+	const double dy = micro_params[1] / nex[1];
+	const int nstress = time_steps * ngp * 6;
+
+	vector<double> ref(nstress);
+	{
+		micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+		solve(micro, ngp, time_steps, ref.data());
+	}
+
+	const int rep[4] = { 1, 2, 1, 1 };
+	const int offset[4] = { 0, 0, 128, 0 };
+	const int bad_phase[4] = { 0, 0, 5, 0 };
+	const int num_mats[4] = { 2, 2, 2, 3 };
+	for (int c = 0; c < 4; ++c) {
+		write_image("micropp_voxels.raw", nex, rep[c], dy, micro_params[3],
+		            offset[c], bad_phase[c], num_mats[c] == 3);
+		const int nvox[3] = { nex[0] * rep[c], nex[1] * rep[c], nex[2] * rep[c] };
+
+		// The image replaces a sphere so the layers come only from it
+		micropp_t micro(dim, size, 0, micro_params,
+		                (num_mats[c] == 3) ? mat_types_3 : mat_types,
+		                (num_mats[c] == 3) ? mat_params_3 : mat_params, num_mats[c]);
+		auto start = high_resolution_clock::now();
+		const bool ok = micro.load_voxels("micropp_voxels.raw", nvox, offset[c]);
+		auto end = high_resolution_clock::now();
+		cout << "image " << nvox[0] << "x" << nvox[1] << "x" << nvox[2] << " loaded in "
+		     << duration_cast<microseconds>(end - start).count() << " us" << endl;
+		assert(ok == (bad_phase[c] == 0));
+		if (!ok)
+			continue;
+
+		vector<double> stress(nstress);
+		solve(micro, ngp, time_steps, stress.data());
+		assert(memcmp(stress.data(), ref.data(), nstress * sizeof(double)) == 0);
+	}
+	remove("micropp_voxels.raw");
+
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+#define dim 3
+#define nmaterials 2
+
+// With the same plastic material in both layers the field is uniform, so
+// the stress of the batched return mapping of every Gauss point is the
+// one of a single point, computed here from the committed eps_p and alpha.
+
+static const double E = 1.0e6, nu = 0.3, Sy = 5.0e3, Ka = 5.0e4;
+
+static void return_mapping(const double eps[6], double eps_p[6], double *alpha,
+                           double stress[6])
+{
+	const double mu = E / (2 * (1 + nu)), k = E / (3 * (1 - 2 * nu));
+	const double tr = eps[0] + eps[1] + eps[2];
+	const double tr_p = eps_p[0] + eps_p[1] + eps_p[2];
+
+	double s[6], norm = 0.0;
+	for (int i = 0; i < 6; ++i) {
+		const double d = (i < 3) ? (eps[i] - tr / 3) - (eps_p[i] - tr_p / 3) : eps[i] - eps_p[i];
+		s[i] = ((i < 3) ? 2 * mu : mu) * d;
+		norm += ((i < 3) ? 1 : 2) * s[i] * s[i];
+	}
+	norm = sqrt(norm);
+
+	const double f = norm - sqrt(2.0 / 3) * (Sy + Ka * *alpha);
+	const double dl = (f > 0) ? f / (2 * mu) : 0.0;
+	for (int i = 0; i < 6; ++i) {
+		const double normal = (f > 0) ? s[i] / norm : 0.0;
+		stress[i] = s[i] + ((i < 3) ? k * tr : 0.0) - 2 * mu * dl * normal;
+		eps_p[i] += dl * normal;
+	}
+	*alpha += sqrt(2.0 / 3) * dl;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 4);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 1};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	for (int m = 0; m < nmaterials; ++m) {
+		mat_params[m * MAX_MAT_PARAM + 0] = E;
+		mat_params[m * MAX_MAT_PARAM + 1] = nu;
+		mat_params[m * MAX_MAT_PARAM + 2] = Sy;
+		mat_params[m * MAX_MAT_PARAM + 3] = Ka;
+	}
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	double eps_p[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 }, alpha = 0.0;
+	bool yielded = false;
+	double time = 0.0;
+
+	for (int t = 0; t < time_steps; ++t) {
+
+		const double a = 0.002 * (t + 1);
+		const double eps[6] = { a, -0.2 * a, 0.1 * a, 0.5 * a, 0.0, -0.3 * a };
+		micro.set_macro_strain(0, eps);
+
+		auto start = high_resolution_clock::now();
+		micro.homogenize();
+		auto end = high_resolution_clock::now();
+		time += duration_cast<microseconds>(end - start).count();
+
+		double stress[6], stress_ref[6];
+		micro.get_macro_stress(0, stress);
+		return_mapping(eps, eps_p, &alpha, stress_ref);
+		yielded = yielded || (alpha > 0.0);
+
+		double err = 0.0, norm = 0.0;
+		for (int i = 0; i < 6; ++i) {
+			err += (stress[i] - stress_ref[i]) * (stress[i] - stress_ref[i]);
+			norm += stress_ref[i] * stress_ref[i];
+		}
+		cout << "step " << t << " alpha " << alpha << " error " << sqrt(err / norm) << endl;
+		assert(sqrt(err / norm) < 1.0e-6);
+
+		micro.update_vars();
+	}
+	assert(yielded);
+
+	cout << "homogenize " << time / 1000 << " ms" << endl;
+	return 0;
+}
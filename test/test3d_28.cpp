@@ -0,0 +1,134 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+
+#include <cmath>
+#include <cstdlib>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+#define dim 3
+#define nmaterials 2
+
+// With a large INV_MAX every point takes the batched linear path. The
+// stresses are CL : E for any number of points (also not a multiple of
+// the block) and the ctans are CL, shared by the points of the owned
+// store (also after it grows) and copied into the caller buffers of
+// set_gp_buffers, which get the same results.
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [ngp]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int ngp = (argc > 4 ? atoi(argv[4]) : 1001);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1 && ngp > 0);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e30};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_b(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	vector<int> id(ngp);
+	vector<double> strain(ngp * 6), stress(ngp * 6), ctan(ngp * 36);
+	vector<double> stress_b(ngp * 6), ctan_b(ngp * 36);
+	srand(7);
+	for (int p = 0; p < ngp; ++p) {
+		id[p] = p;
+		for (int i = 0; i < 6; ++i)
+			strain[p * 6 + i] = 1.0e-3 * (rand() / (double) RAND_MAX - 0.5);
+	}
+
+	micro.set_macro_strains(ngp, id.data(), strain.data());
+	micro_b.set_gp_buffers(ngp, id.data(), strain.data(), stress_b.data(), ctan_b.data());
+
+	auto start = high_resolution_clock::now();
+	micro.homogenize();
+	auto end = high_resolution_clock::now();
+	cout << ngp << " linear points in "
+	     << duration_cast<microseconds>(end - start).count() << " us" << endl;
+	micro_b.homogenize();
+
+	micro.get_macro_stresses(ngp, id.data(), stress.data());
+	micro.get_macro_ctans(ngp, id.data(), ctan.data());
+
+	const double *cl = &ctan[0];
+	for (int p = 0; p < ngp; ++p) {
+		int non_linear;
+		micro.get_nl_flag(p, &non_linear);
+		assert(non_linear == 0);
+
+		for (int i = 0; i < 36; ++i) {
+			assert(ctan[p * 36 + i] == cl[i]);
+			assert(ctan_b[p * 36 + i] == cl[i]);
+		}
+		for (int i = 0; i < 6; ++i) {
+			double sig = 0.0, norm = 0.0;
+			for (int j = 0; j < 6; ++j) {
+				sig += cl[i * 6 + j] * strain[p * 6 + j];
+				norm += fabs(cl[i * 6 + j] * strain[p * 6 + j]);
+			}
+			assert(fabs(stress[p * 6 + i] - sig) <= 1.0e-12 * norm);
+			assert(stress_b[p * 6 + i] == stress[p * 6 + i]);
+		}
+	}
+
+	// A new point moves the owned store, the rows take CL
+	micro.set_macro_strain(ngp, &strain[0]);
+	micro.get_macro_ctans(ngp, id.data(), ctan.data());
+	for (int p = 0; p < ngp; ++p)
+		for (int i = 0; i < 36; ++i)
+			assert(ctan[p * 36 + i] == ctan_b[i]);
+
+	return 0;
+}
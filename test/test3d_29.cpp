@@ -0,0 +1,122 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 4
+
+// Point 1 has the strain of point 0 (exact hit), point 2 is 1e-7 away
+// (near hit, interpolated with the stored ctan) and point 3 is far (miss).
+// The stresses match the run without cache and the committed states of
+// points 0 and 1 keep hitting each other in the next steps.
+
+static void set_strains(micropp_t &micro, const int t)
+{
+	for (int p = 0; p < ngp; ++p) {
+		double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+		eps[0] = 0.005 * (t + 1);
+		if (p == 2)
+			eps[1] = 1.0e-7;
+		if (p == 3)
+			eps[1] = 0.001;
+		micro.set_macro_strain(p, eps);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 2);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_ref(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micro.set_cache(true, 1.0e-5, 64);
+
+	for (int t = 0; t < time_steps; ++t) {
+
+		set_strains(micro, t);
+		set_strains(micro_ref, t);
+		micro.homogenize();
+		micro_ref.homogenize();
+
+		long hits, near_hits, misses;
+		micro.get_cache_stats(&hits, &near_hits, &misses);
+		cout << "step " << t << " hits = " << hits << " near hits = " << near_hits
+		     << " misses = " << misses << endl;
+		assert(hits == t + 1 && near_hits == t + 1 && misses == 2 * (t + 1));
+
+		for (int p = 0; p < ngp; ++p) {
+			double sig[6], sig_ref[6];
+			micro.get_macro_stress(p, sig);
+			micro_ref.get_macro_stress(p, sig_ref);
+			double norm = 0.0, norm_err = 0.0;
+			for (int i = 0; i < 6; ++i) {
+				norm += sig_ref[i] * sig_ref[i];
+				norm_err += (sig[i] - sig_ref[i]) * (sig[i] - sig_ref[i]);
+			}
+			assert(sqrt(norm_err) <= ((p == 2) ? 1.0e-6 : 1.0e-12) * sqrt(norm));
+		}
+
+		micro.update_vars();
+		micro_ref.update_vars();
+	}
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cstdlib>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+
+// The sparse B^T C B of get_elem_mat_btcb is the dense product of
+// calc_bmat_3D, for a random non-symmetric ctan per Gauss point and for a
+// symmetric one (which only computes the upper blocks).
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          2.0,		// ly
+	                          3.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	const double wg = (1 / 8.0) * (micro_params[0] / (nx - 1)) *
+		(micro_params[1] / (ny - 1)) * (micro_params[2] / (nz - 1));
+
+	srand(11);
+	for (int sym = 0; sym < 2; ++sym) {
+
+		double ctan[6][6][8];
+		for (int gp = 0; gp < 8; ++gp)
+			for (int i = 0; i < 6; ++i)
+				for (int j = 0; j < 6; ++j)
+					ctan[i][j][gp] = (sym && j < i) ? ctan[j][i][gp] :
+						1.0e6 * (rand() / (double) RAND_MAX - 0.5);
+
+		double Ae[3 * 8 * 3 * 8], Ae_ref[3 * 8 * 3 * 8] = { 0.0 };
+		micro.get_elem_mat_btcb(ctan, Ae);
+
+		for (int gp = 0; gp < 8; ++gp) {
+			double bmat[6][3 * 8];
+			micro.calc_bmat_3D(gp, bmat);
+			for (int a = 0; a < 3 * 8; ++a)
+				for (int b = 0; b < 3 * 8; ++b) {
+					double val = 0.0;
+					for (int i = 0; i < 6; ++i)
+						for (int j = 0; j < 6; ++j)
+							val += bmat[i][a] * ctan[i][j][gp] * bmat[j][b];
+					Ae_ref[a * 3 * 8 + b] += val * wg;
+				}
+		}
+
+		double norm = 0.0, err = 0.0;
+		for (int i = 0; i < 3 * 8 * 3 * 8; ++i) {
+			norm = max(norm, fabs(Ae_ref[i]));
+			err = max(err, fabs(Ae[i] - Ae_ref[i]));
+		}
+		cout << (sym ? "symmetric" : "non-symmetric") << " ctan : max |Ae| = " << norm
+		     << " max error = " << err << endl;
+		assert(err <= 1.0e-12 * norm);
+	}
+
+	return 0;
+}
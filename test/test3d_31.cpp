@@ -0,0 +1,124 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 3
+
+// With set_gp_buffers the strains are read from the caller arrays and the
+// stresses and ctans are written there, every step and in the gp_id
+// order given. The results match the points set one by one.
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 2);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_ref(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	const int gp_id[ngp] = { 7, 3, 11 };
+	double strain[ngp * 6] = { 0.0 }, stress[ngp * 6], ctan[ngp * 36];
+	micro.set_gp_buffers(ngp, gp_id, strain, stress, ctan);
+
+	for (int t = 0; t < time_steps; ++t) {
+
+		// Written straight into the caller array, the last point with
+		// set_macro_strain, which also lands there
+		for (int p = 0; p < ngp; ++p) {
+			double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			eps[p] = 0.005 * (t + 1);
+			if (p < ngp - 1) {
+				for (int i = 0; i < 6; ++i)
+					strain[p * 6 + i] = eps[i];
+			} else {
+				micro.set_macro_strain(gp_id[p], eps);
+				for (int i = 0; i < 6; ++i)
+					assert(strain[p * 6 + i] == eps[i]);
+			}
+			micro_ref.set_macro_strain(gp_id[p], eps);
+		}
+
+		for (int i = 0; i < ngp * 6; ++i)
+			stress[i] = NAN;
+		for (int i = 0; i < ngp * 36; ++i)
+			ctan[i] = NAN;
+		micro.homogenize();
+		micro_ref.homogenize();
+
+		for (int p = 0; p < ngp; ++p) {
+			double sig[6], sig_ref[6], ctan_ref[36];
+			micro.get_macro_stress(gp_id[p], sig);
+			micro_ref.get_macro_stress(gp_id[p], sig_ref);
+			micro_ref.get_macro_ctan(gp_id[p], ctan_ref);
+			for (int i = 0; i < 6; ++i)
+				assert(stress[p * 6 + i] == sig[i] && sig[i] == sig_ref[i]);
+			for (int i = 0; i < 36; ++i)
+				assert(ctan[p * 36 + i] == ctan_ref[i]);
+			cout << "t = " << t << " gp " << gp_id[p] << " stress[" << p << "] = "
+			     << stress[p * 6 + p] << endl;
+		}
+
+		micro.update_vars();
+		micro_ref.update_vars();
+	}
+
+	return 0;
+}
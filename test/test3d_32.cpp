@@ -0,0 +1,141 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 2
+
+// A macro Newton loop calls homogenize twice in the first step. In the
+// first call point 0 yields and point 1 is elastic, in the second one both
+// have the strain of point 1 and point 0 is served by its elastic response
+// (cache and surrogate). The trial of the first call is not committed, so
+// the stresses match a run that only sees the second strains.
+
+static void set_strains(micropp_t &micro, const double eps_0, const double eps_1)
+{
+	double eps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	eps[0] = eps_0;
+	micro.set_macro_strain(0, eps);
+	eps[0] = eps_1;
+	micro.set_macro_strain(1, eps);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;	// 2 materials in layers
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.5,		// width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] = { 0.0 };
+	mat_params[0 * MAX_MAT_PARAM + 0] = 1.0e6;	// E
+	mat_params[0 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+	mat_params[0 * MAX_MAT_PARAM + 2] = 5.0e3;	// Sy
+	mat_params[0 * MAX_MAT_PARAM + 3] = 5.0e4;	// Ka
+
+	mat_params[1 * MAX_MAT_PARAM + 0] = 1.0e7;	// E
+	mat_params[1 * MAX_MAT_PARAM + 1] = 0.3;	// nu
+
+	micropp_t micro_ref(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_c(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_d(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micropp_t micro_s(dim, size, micro_type, micro_params, mat_types, mat_params);
+	micro_c.set_cache(true, 0.0, 64);
+	micro_d.set_cache(true, 0.0, 64);
+	micro_d.set_dedup(true);
+	micro_s.set_surrogate(true, 1.0e-3, 64, 1.0e-3);
+	micropp_t *micros[3] = { &micro_c, &micro_d, &micro_s };
+
+	const double eps_el[2] = { 1.0e-4, 2.0e-4 };
+
+	for (int t = 0; t < 2; ++t) {
+
+		set_strains(micro_ref, eps_el[t], eps_el[t]);
+		micro_ref.homogenize();
+
+		for (int m = 0; m < 3; ++m) {
+			if (t == 0) {
+				set_strains(*micros[m], 0.01, eps_el[t]);
+				micros[m]->homogenize();
+			}
+			set_strains(*micros[m], eps_el[t], eps_el[t]);
+			micros[m]->homogenize();
+		}
+
+		long hits, near_hits, misses;
+		int served, solved;
+		micro_c.get_cache_stats(&hits, &near_hits, &misses);
+		micro_s.get_surrogate_stats(&served, &solved);
+		cout << "step " << t << " cache hits = " << hits
+		     << " surrogate served = " << served << endl;
+		if (t == 0)
+			assert(hits == 2 && served == 2);
+
+		for (int p = 0; p < ngp; ++p) {
+			double sig_ref[6];
+			micro_ref.get_macro_stress(p, sig_ref);
+			for (int m = 0; m < 3; ++m) {
+				double sig[6], norm = 0.0, norm_err = 0.0;
+				micros[m]->get_macro_stress(p, sig);
+				for (int i = 0; i < 6; ++i) {
+					norm += sig_ref[i] * sig_ref[i];
+					norm_err += (sig[i] - sig_ref[i]) * (sig[i] - sig_ref[i]);
+				}
+				cout << "gp " << p << " micro " << m << " error "
+				     << sqrt(norm_err / norm) << endl;
+				assert(sqrt(norm_err) <= 1.0e-6 * sqrt(norm));
+			}
+		}
+
+		micro_ref.update_vars();
+		for (int m = 0; m < 3; ++m)
+			micros[m]->update_vars();
+	}
+
+	return 0;
+}
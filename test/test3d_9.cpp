@@ -0,0 +1,128 @@
+/*
+ *  This is a test example for MicroPP: a finite element library
+ *  to solve microstructural problems for composite materials.
+ *
+ *  Copyright (C) - 2018 - Guido Giuntoli <gagiuntoli@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <cmath>
+#include <cassert>
+
+#include "micro.hpp"
+
+using namespace std;
+
+#define dim 3
+#define nmaterials 2
+#define ngp 4
+
+// Checks that the batched interface gives the same results as the
+// per Gauss point one
+
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " nx ny nz [steps]" << endl;
+		return(1);
+	}
+
+	const int nx = atoi(argv[1]);
+	const int ny = atoi(argv[2]);
+	const int nz = atoi(argv[3]);
+	const int time_steps = (argc > 4 ? atoi(argv[4]) : 10);  // Optional value
+
+	assert(nx > 1 && ny > 1 && nz > 1);
+
+	int size[dim] = {nx, ny, nz};
+
+	int micro_type = 1;
+
+	double micro_params[5] = {1.0,		// lx
+	                          1.0,		// ly
+	                          1.0,		// lz
+	                          0.1,		// Layer width
+	                          1.0e-5};	// INV_MAX
+
+	int mat_types[nmaterials] = {1, 0};
+
+	double mat_params[nmaterials * MAX_MAT_PARAM] =	{
+		// Material 0
+		1.0e6,	// E
+		0.3,	// nu
+		5.0e4,	// Sy
+		5.0e4,	// Ka
+		// Material 1
+		1.0e6,
+		0.3,
+		1.0e4,
+		0.0e-1 };
+
+	micropp_t micro(dim, size, micro_type, micro_params, mat_types, mat_params);
+
+	int gp_id[ngp] = {7, 3, 11, 5};
+	double eps[ngp * 6], sig[ngp * 6], ctan[ngp * 36];
+	double sig_1[6], ctan_1[36];
+
+	for (int i = 0; i < ngp * 6; ++i)
+		eps[i] = 0.0;
+
+	for (int t = 0; t < time_steps; ++t) {
+		cout << "Time step = " << t << endl;
+
+		for (int gp = 0; gp < ngp; ++gp)
+			eps[gp * 6 + (gp % 3)] += 0.005 * (gp + 1);
+
+		micro.set_macro_strains(ngp, gp_id, eps);
+		micro.homogenize();
+		micro.get_macro_stresses(ngp, gp_id, sig);
+		micro.get_macro_ctans(ngp, gp_id, ctan);
+
+		for (int gp = 0; gp < ngp; ++gp) {
+			micro.get_macro_stress(gp_id[gp], sig_1);
+			micro.get_macro_ctan(gp_id[gp], ctan_1);
+			for (int i = 0; i < 6; ++i)
+				assert(sig_1[i] == sig[gp * 6 + i]);
+			for (int i = 0; i < 36; ++i)
+				assert(ctan_1[i] == ctan[gp * 36 + i]);
+
+			cout << "gp = " << gp_id[gp] << " sig = " << scientific;
+			for (int i = 0; i < 6; ++i)
+				cout << setw(14) << sig[gp * 6 + i] << " ";
+			cout << endl;
+		}
+
+		micro.update_vars();
+		cout << endl;
+	}
+
+	// Two int_vars blocks per non-linear point come from the arena
+	int nl_points = 0;
+	for (int gp = 0; gp < ngp; ++gp) {
+		int nl_flag;
+		micro.get_nl_flag(gp_id[gp], &nl_flag);
+		nl_points += nl_flag;
+	}
+	size_t reserved, in_use;
+	micro.get_arena_stats(&reserved, &in_use);
+	cout << "arena reserved = " << reserved << " in use = " << in_use << endl;
+	assert(in_use <= reserved);
+	assert((in_use == 0) == (nl_points == 0));
+
+	return 0;
+}